@@ -11,6 +11,8 @@
 
 #include "Memory.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <istream>
 #include <stdexcept>
 #include <string>
@@ -27,6 +29,15 @@ enum
     ISTREAM_SEEK_END
 };
 
+class IOException : public std::runtime_error
+{
+public:
+    explicit IOException(const std::string& message)
+        : std::runtime_error(message)
+    {
+    }
+};
+
 /**
  * Represents a stream that can be read or written to. Implemented by types such as FileStream, NetworkStream or MemoryStream.
  */
@@ -191,6 +202,35 @@ struct IStream
         return buffer;
     }
 
+    /**
+     * Reads `count` values into the given buffer with a single read.
+     */
+    template<typename T> void ReadArray(T* buffer, size_t count)
+    {
+        Read(buffer, sizeof(T) * count);
+    }
+
+    /**
+     * Decodes `count` packed little-endian records described by `Layout` (see RecordLayout) into consecutive items.
+     * The length is validated once for the whole array, the records are then read in blocks and decoded without
+     * further checks. Fields of the items not named in the layout are left untouched.
+     */
+    template<typename Layout, typename T> void ReadRecords(T* items, size_t count)
+    {
+        if (count > (GetLength() - GetPosition()) / Layout::Size)
+        {
+            throw IOException("Attempted to read past end of stream.");
+        }
+        constexpr size_t blockRecords = 256;
+        uint8_t block[blockRecords * Layout::Size];
+        for (size_t i = 0; i < count; i += blockRecords)
+        {
+            size_t n = std::min(blockRecords, count - i);
+            Read(block, n * Layout::Size);
+            Layout::Decode(block, items + i, n);
+        }
+    }
+
     template<typename T> void WriteArray(T * buffer, size_t count)
     {
         Write(buffer, sizeof(T) * count);
@@ -200,12 +240,42 @@ struct IStream
     std::string ReadStdString();
 };
 
-class IOException : public std::runtime_error
+/**
+ * A field of a packed record: stored as `TStored`, widened to `TField` and written `Offset` bytes into the item.
+ */
+template<typename TStored, typename TField, size_t Offset> struct RecordField
 {
-public:
-    explicit IOException(const std::string& message)
-        : std::runtime_error(message)
+    using Stored = TStored;
+    using Field = TField;
+    static constexpr size_t FieldOffset = Offset;
+};
+
+/**
+ * Describes a packed record as its RecordFields in storage order. Everything is known at compile time, so Decode()
+ * is a fixed sequence of loads and stores per record with no branches the compiler has to keep.
+ */
+template<typename... Fields> struct RecordLayout
+{
+    static constexpr size_t Size = (sizeof(typename Fields::Stored) + ...);
+
+    template<typename T> static void Decode(const uint8_t* src, T* items, size_t count)
+    {
+        for (size_t i = 0; i < count; i++, src += Size)
+        {
+            uint8_t* item = (uint8_t*)&items[i];
+            const uint8_t* field = src;
+            (DecodeField<Fields>(field, item), ...);
+        }
+    }
+
+private:
+    template<typename F> static void DecodeField(const uint8_t*& src, uint8_t* item)
     {
+        typename F::Stored stored;
+        std::memcpy(&stored, src, sizeof(stored));
+        typename F::Field value = (typename F::Field)stored;
+        std::memcpy(item + F::FieldOffset, &value, sizeof(value));
+        src += sizeof(stored);
     }
 };
 
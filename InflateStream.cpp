@@ -0,0 +1,220 @@
+#include "InflateStream.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <string>
+
+InflateStream::InflateStream(const void* data, uint64_t dataSize, uint64_t length, size_t chunkSize)
+    : _input((const uint8_t*)data)
+    , _inputRemaining(dataSize)
+    , _chunk(std::make_unique<uint8_t[]>(chunkSize))
+    , _chunkSize(chunkSize)
+    , _length(length)
+{
+    if (inflateInit(&_zs) != Z_OK)
+    {
+        throw IOException("Failed to initialise zlib.");
+    }
+}
+
+InflateStream::~InflateStream()
+{
+    inflateEnd(&_zs);
+}
+
+size_t InflateStream::Inflate(uint8_t* buffer, size_t size)
+{
+    _zs.next_out = buffer;
+    _zs.avail_out = (uInt)std::min<size_t>(size, UINT_MAX);
+    while (_zs.avail_out > 0 && !_finished)
+    {
+        if (_zs.avail_in == 0 && _inputRemaining > 0)
+        {
+            // avail_in is only 32 bits wide, multi-GB captures are handed over in slices
+            uInt slice = (uInt)std::min<uint64_t>(_inputRemaining, 1u << 30);
+            _zs.next_in = (Bytef*)_input;
+            _zs.avail_in = slice;
+            _input += slice;
+            _inputRemaining -= slice;
+        }
+        int result = inflate(&_zs, Z_NO_FLUSH);
+        if (result == Z_STREAM_END)
+        {
+            _finished = true;
+        }
+        else if (result == Z_BUF_ERROR && _zs.avail_in == 0 && _inputRemaining == 0)
+        {
+            throw IOException("Compressed stream is truncated.");
+        }
+        else if (result != Z_OK && result != Z_BUF_ERROR)
+        {
+            throw IOException(std::string("Failed to inflate: ") + (_zs.msg != nullptr ? _zs.msg : zError(result)));
+        }
+    }
+    return (size_t)((uint8_t*)_zs.next_out - buffer);
+}
+
+size_t InflateStream::ChunkRefillSize() const
+{
+    // The chunk is only refilled once drained, so everything inflated so far has been read
+    return (size_t)std::min<uint64_t>(_chunkSize, _length - _position);
+}
+
+bool InflateStream::AtEnd()
+{
+    uint8_t extra;
+    return _position == _length && Inflate(&extra, 1) == 0 && _finished;
+}
+
+const void* InflateStream::GetData() const
+{
+    return nullptr;
+}
+
+bool InflateStream::CanRead() const
+{
+    return true;
+}
+
+bool InflateStream::CanWrite() const
+{
+    return false;
+}
+
+uint64_t InflateStream::GetLength() const
+{
+    return _length;
+}
+
+uint64_t InflateStream::GetPosition() const
+{
+    return _position;
+}
+
+void InflateStream::SetPosition(uint64_t position)
+{
+    Seek(position, ISTREAM_SEEK_BEGIN);
+}
+
+void InflateStream::Seek(int64_t offset, int32_t origin)
+{
+    uint64_t newPosition;
+    switch (origin)
+    {
+        default:
+        case ISTREAM_SEEK_BEGIN:
+            newPosition = offset;
+            break;
+        case ISTREAM_SEEK_CURRENT:
+            newPosition = _position + offset;
+            break;
+        case ISTREAM_SEEK_END:
+            newPosition = _length + offset;
+            break;
+    }
+
+    if (newPosition < _position)
+    {
+        throw IOException("InflateStream can only seek forward.");
+    }
+    uint8_t scratch[4096];
+    while (_position < newPosition)
+    {
+        Read(scratch, std::min<uint64_t>(sizeof(scratch), newPosition - _position));
+    }
+}
+
+void InflateStream::Read(void* buffer, uint64_t length)
+{
+    uint8_t* destination = (uint8_t*)buffer;
+    if (length > _length - _position)
+    {
+        throw IOException("Attempted to read past end of stream.");
+    }
+    while (length > 0)
+    {
+        if (_chunkPosition == _chunkEnd)
+        {
+            if (length >= _chunkSize)
+            {
+                // Large reads skip the chunk and inflate straight into the destination
+                size_t inflated = Inflate(destination, (size_t)std::min<uint64_t>(length, SIZE_MAX));
+                if (inflated == 0)
+                {
+                    throw IOException("Attempted to read past end of stream.");
+                }
+                destination += inflated;
+                length -= inflated;
+                _position += inflated;
+                continue;
+            }
+            _chunkPosition = 0;
+            _chunkEnd = Inflate(_chunk.get(), ChunkRefillSize());
+            if (_chunkEnd == 0)
+            {
+                throw IOException("Attempted to read past end of stream.");
+            }
+        }
+        size_t count = (size_t)std::min<uint64_t>(length, _chunkEnd - _chunkPosition);
+        std::memcpy(destination, _chunk.get() + _chunkPosition, count);
+        _chunkPosition += count;
+        destination += count;
+        length -= count;
+        _position += count;
+    }
+}
+
+void InflateStream::Read1(void* buffer)
+{
+    Read<1>(buffer);
+}
+
+void InflateStream::Read2(void* buffer)
+{
+    Read<2>(buffer);
+}
+
+void InflateStream::Read4(void* buffer)
+{
+    Read<4>(buffer);
+}
+
+void InflateStream::Read8(void* buffer)
+{
+    Read<8>(buffer);
+}
+
+void InflateStream::Read16(void* buffer)
+{
+    Read<16>(buffer);
+}
+
+void InflateStream::Write(const void*, uint64_t)
+{
+    throw IOException("InflateStream is read-only.");
+}
+
+uint64_t InflateStream::TryRead(void* buffer, uint64_t length)
+{
+    uint8_t* destination = (uint8_t*)buffer;
+    uint64_t total = 0;
+    while (total < length)
+    {
+        if (_chunkPosition == _chunkEnd)
+        {
+            _chunkPosition = 0;
+            _chunkEnd = Inflate(_chunk.get(), ChunkRefillSize());
+            if (_chunkEnd == 0)
+            {
+                break;
+            }
+        }
+        size_t count = (size_t)std::min<uint64_t>(length - total, _chunkEnd - _chunkPosition);
+        std::memcpy(destination + total, _chunk.get() + _chunkPosition, count);
+        _chunkPosition += count;
+        _position += count;
+        total += count;
+    }
+    return total;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "IStream.hpp"
+
+#include <cstring>
+#include <memory>
+#include <zlib.h>
+
+/**
+ * A forward-only stream that inflates a zlib buffer on demand, one bounded chunk at a time,
+ * so consumers can start decoding long before the whole buffer has been decompressed.
+ */
+class InflateStream final : public IStream
+{
+private:
+    z_stream _zs{};
+    const uint8_t* _input = nullptr;
+    uint64_t _inputRemaining = 0;
+    std::unique_ptr<uint8_t[]> _chunk;
+    size_t _chunkSize = 0;
+    size_t _chunkPosition = 0;
+    size_t _chunkEnd = 0;
+    uint64_t _length = 0;
+    uint64_t _position = 0;
+    bool _finished = false;
+
+public:
+    /**
+     * @param length the expected inflated size, reported by GetLength(). Reads never go past it.
+     */
+    InflateStream(const void* data, uint64_t dataSize, uint64_t length, size_t chunkSize = 256 * 1024);
+    InflateStream(const InflateStream&) = delete;
+    InflateStream& operator=(const InflateStream&) = delete;
+    ~InflateStream() override;
+
+    /**
+     * Whether all of GetLength() has been read and the compressed stream ends exactly there.
+     * Inflates at most one byte past the length to find out.
+     */
+    bool AtEnd();
+
+    const void* GetData() const override;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // ISteam methods
+    ///////////////////////////////////////////////////////////////////////////
+    bool CanRead() const override;
+    bool CanWrite() const override;
+
+    uint64_t GetLength() const override;
+    uint64_t GetPosition() const override;
+    void SetPosition(uint64_t position) override;
+    void Seek(int64_t offset, int32_t origin) override;
+
+    void Read(void* buffer, uint64_t length) override;
+    void Read1(void* buffer) override;
+    void Read2(void* buffer) override;
+    void Read4(void* buffer) override;
+    void Read8(void* buffer) override;
+    void Read16(void* buffer) override;
+
+    template<size_t N> void Read(void* buffer)
+    {
+        if (_chunkEnd - _chunkPosition >= N)
+        {
+            std::memcpy(buffer, _chunk.get() + _chunkPosition, N);
+            _chunkPosition += N;
+            _position += N;
+        }
+        else
+        {
+            Read(buffer, N);
+        }
+    }
+
+    void Write(const void* buffer, uint64_t length) override;
+
+    uint64_t TryRead(void* buffer, uint64_t length) override;
+
+private:
+    size_t Inflate(uint8_t* buffer, size_t size);
+    size_t ChunkRefillSize() const;
+};
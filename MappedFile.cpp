@@ -0,0 +1,204 @@
+#include "MappedFile.h"
+
+#include <cstdio>
+#include <cstdlib>
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const char* path)
+{
+#ifdef _WIN32
+    _file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (_file == INVALID_HANDLE_VALUE)
+    {
+        _file = nullptr;
+        return;
+    }
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0)
+    {
+        return;
+    }
+    _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_mapping != nullptr)
+    {
+        _data = (const uint8_t*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+        _size = (size_t)size.QuadPart;
+        _mapped = _data != nullptr;
+    }
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        return;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+            // Captures are consumed front to back exactly once
+            madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+            _data = (const uint8_t*)data;
+            _size = (size_t)st.st_size;
+            _mapped = true;
+        }
+    }
+    close(fd);
+#endif
+    if (_data == nullptr)
+    {
+        // Mapping is not available (e.g. a pipe), read it the old-fashioned way
+        FILE* file = fopen(path, "rb");
+        if (file == nullptr)
+        {
+            return;
+        }
+        size_t capacity = 1 << 20;
+        uint8_t* buffer = (uint8_t*)malloc(capacity);
+        size_t read;
+        while (buffer != nullptr && (read = fread(buffer + _size, 1, capacity - _size, file)) > 0)
+        {
+            _size += read;
+            if (_size == capacity)
+            {
+                capacity *= 2;
+                uint8_t* grown = (uint8_t*)realloc(buffer, capacity);
+                if (grown == nullptr)
+                {
+                    free(buffer);
+                }
+                buffer = grown;
+            }
+        }
+        fclose(file);
+        if (buffer == nullptr || _size == 0)
+        {
+            free(buffer);
+            _size = 0;
+            return;
+        }
+        _data = buffer;
+    }
+}
+
+MappedFile::MappedFile(const char* path, uint64_t offset, size_t alignment, bool writable)
+{
+#ifdef _WIN32
+    // The offset has to be a multiple of the allocation granularity (64KiB)
+    _file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (_file == INVALID_HANDLE_VALUE)
+    {
+        _file = nullptr;
+        return;
+    }
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(_file, &size) || (uint64_t)size.QuadPart <= offset)
+    {
+        return;
+    }
+    _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_mapping == nullptr)
+    {
+        return;
+    }
+    size_t length = (size_t)((uint64_t)size.QuadPart - offset);
+    // There is no way to ask for an aligned view: find an aligned hole and try to map into it before anyone else does.
+    for (int attempt = 0; attempt < 16 && _data == nullptr; attempt++)
+    {
+        void* reserve = VirtualAlloc(nullptr, length + alignment, MEM_RESERVE, PAGE_NOACCESS);
+        if (reserve == nullptr)
+        {
+            return;
+        }
+        uintptr_t aligned = ((uintptr_t)reserve + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        VirtualFree(reserve, 0, MEM_RELEASE);
+        _data = (const uint8_t*)MapViewOfFileEx(_mapping, writable ? FILE_MAP_COPY : FILE_MAP_READ, (DWORD)(offset >> 32),
+            (DWORD)offset, length, (void*)aligned);
+    }
+    if (_data != nullptr)
+    {
+        _size = length;
+        _mapped = true;
+        _writable = writable;
+    }
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        return;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) == 0 && (uint64_t)st.st_size > offset)
+    {
+        size_t length = (size_t)((uint64_t)st.st_size - offset);
+        // Reserve enough address space to contain an aligned start, map over it and return the slack
+        size_t reserve_length = length + alignment;
+        void* reserve = mmap(nullptr, reserve_length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (reserve != MAP_FAILED)
+        {
+            uintptr_t begin = (uintptr_t)reserve;
+            uintptr_t aligned = (begin + alignment - 1) & ~(uintptr_t)(alignment - 1);
+            int prot = PROT_READ | (writable ? PROT_WRITE : 0);
+            void* data = mmap((void*)aligned, length, prot, MAP_PRIVATE | MAP_FIXED, fd, (off_t)offset);
+            if (data == MAP_FAILED)
+            {
+                munmap(reserve, reserve_length);
+            }
+            else
+            {
+                uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+                uintptr_t end = (aligned + length + page - 1) & ~(page - 1);
+                if (aligned > begin)
+                {
+                    munmap(reserve, aligned - begin);
+                }
+                if (begin + reserve_length > end)
+                {
+                    munmap((void*)end, begin + reserve_length - end);
+                }
+                _data = (const uint8_t*)data;
+                _size = length;
+                _mapped = true;
+                _writable = writable;
+            }
+        }
+    }
+    close(fd);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    if (!_mapped)
+    {
+        free((void*)_data);
+    }
+#ifdef _WIN32
+    else
+    {
+        UnmapViewOfFile(_data);
+    }
+    if (_mapping != nullptr)
+    {
+        CloseHandle(_mapping);
+    }
+    if (_file != nullptr)
+    {
+        CloseHandle(_file);
+    }
+#else
+    else
+    {
+        munmap((void*)_data, _size);
+    }
+#endif
+}
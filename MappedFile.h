@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Read-only view of a whole file. Maps it where the platform allows and falls back to reading it into memory.
+ * The aligned form maps everything from `offset` on at an address that is a multiple of `alignment`, optionally as
+ * private copy-on-write pages. It never falls back to reading and is only open if the mapping succeeded.
+ */
+class MappedFile final
+{
+private:
+    const uint8_t* _data = nullptr;
+    size_t _size = 0;
+    bool _mapped = false;
+    bool _writable = false;
+#ifdef _WIN32
+    void* _file = nullptr;
+    void* _mapping = nullptr;
+#endif
+
+public:
+    explicit MappedFile(const char* path);
+    MappedFile(const char* path, uint64_t offset, size_t alignment, bool writable);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool IsOpen() const
+    {
+        return _data != nullptr;
+    }
+    const uint8_t* GetData() const
+    {
+        return _data;
+    }
+    uint8_t* GetMutableData() const
+    {
+        return _writable ? (uint8_t*)_data : nullptr;
+    }
+    size_t GetSize() const
+    {
+        return _size;
+    }
+};
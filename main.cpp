@@ -2,23 +2,45 @@
 #include "MemoryStream.h"
 #include "structs.h"
 #include "psa_openrct2.h"
+#include "psa_journal.h"
+#include "psa_arrange_cache.h"
+#include "psa_corpus.h"
+#include "psa_frame.h"
+#include "psa_opcounters.h"
+#include "psa_perf.h"
+#include "psa_pipeline.h"
+#include "psa_raster.h"
+#include "psa_synth.h"
+#include "psa_submit.h"
+#include "psa_batch.h"
 
 #ifdef WITH_BENCHMARK
 #include <benchmark/benchmark.h>
 #endif
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
 #include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <iterator>
 #include <memory>
+#include <numeric>
+#include <random>
+#include <thread>
 #ifdef __linux
+    #include <glob.h>
     #include <sys/mman.h>
+    #include <sys/resource.h>
+    #include <unistd.h>
 #elif defined(_WIN32)
     #define WIN32_LEAN_AND_MEAN
     #include <windows.h>
     #include <shellapi.h>
+    #include <psapi.h>
 #endif
-#include <zlib.h>
 
 #define RCT2_ADDRESS_CURRENT_ROTATION 0x0141E9E0
 
@@ -28,6 +50,29 @@ static bool platform_file_exists(const utf8* path)
     bool exists = access(path, F_OK) != -1;
     return exists;
 }
+
+static size_t platform_peak_rss()
+{
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return (size_t)usage.ru_maxrss * 1024;
+}
+
+// For patterns the shell left alone: quoted ones, or ones that would expand past the argument limit
+static std::vector<std::string> platform_glob(const char* pattern)
+{
+    std::vector<std::string> paths;
+    glob_t result{};
+    if (glob(pattern, 0, nullptr, &result) == 0)
+    {
+        for (size_t i = 0; i < result.gl_pathc; i++)
+        {
+            paths.push_back(result.gl_pathv[i]);
+        }
+    }
+    globfree(&result);
+    return paths;
+}
 #elif defined(_WIN32)
 static bool platform_file_exists(const utf8* path)
 {
@@ -35,142 +80,67 @@ static bool platform_file_exists(const utf8* path)
     DWORD error = GetLastError();
     return !(result == INVALID_FILE_ATTRIBUTES && (error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND));
 }
-#endif
-
-static paint_struct read_paint_struct(MemoryStream &ms)
-{
-    paint_struct ps;
-    ps.bounds.x = ms.ReadValue<uint16_t>();
-    ps.bounds.y = ms.ReadValue<uint16_t>();
-    ps.bounds.z = ms.ReadValue<uint16_t>();
-    ps.bounds.x_end = ms.ReadValue<uint16_t>();
-    ps.bounds.y_end = ms.ReadValue<uint16_t>();
-    ps.bounds.z_end = ms.ReadValue<uint16_t>();
-    ps.next_quadrant_ps = (paint_struct *)(uintptr_t)ms.ReadValue<uint32_t>();
-    ps.quadrant_flags = ms.ReadValue<uint8_t>();
-    ps.quadrant_index = ms.ReadValue<uint8_t>();
-    ps.x = ms.ReadValue<uint16_t>();
-    ps.y = ms.ReadValue<uint16_t>();
-    ps.image_id = ms.ReadValue<uint32_t>();
-    return ps;
-}
 
-static std::vector<paint_session> read_sessions(MemoryStream& ms)
+static size_t platform_peak_rss()
 {
-    uint32_t sessions_count = ms.ReadValue<uint32_t>();
-    std::vector<paint_session> sessions(sessions_count);
-    for (uint32_t i = 0; i < sessions_count; i++) {
-        auto& session = sessions[i];
-        for (int j = 0; j < 4000; j++) {
-            session.PaintStructs[j].basic = read_paint_struct(ms);
-        }
-        for (int j = 0; j < 512; j++) {
-            session.Quadrants[j] = (paint_struct *)(uintptr_t)ms.ReadValue<uint32_t>();
-        }
-        session.PaintHead = read_paint_struct(ms);
-        session.QuadrantFrontIndex = ms.ReadValue<uint32_t>();
-        session.QuadrantBackIndex = ms.ReadValue<uint32_t>();
-    }
-    return sessions;
+    PROCESS_MEMORY_COUNTERS counters{};
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize;
 }
 
-static void fixup_pointers(paint_session* s, size_t paint_session_entries, size_t paint_struct_entries, size_t quadrant_entries)
+// cmd.exe never expands patterns itself
+static std::vector<std::string> platform_glob(const char* pattern)
 {
-    for (size_t i = 0; i < paint_session_entries; i++)
+    std::vector<std::string> paths;
+    std::string directory(pattern);
+    size_t separator = directory.find_last_of("\\/");
+    directory.resize(separator == std::string::npos ? 0 : separator + 1);
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(pattern, &data);
+    if (find != INVALID_HANDLE_VALUE)
     {
-        for (size_t j = 0; j < paint_struct_entries; j++)
-        {
-            if (s[i].PaintStructs[j].basic.next_quadrant_ps == (paint_struct*)paint_struct_entries)
-            {
-                s[i].PaintStructs[j].basic.next_quadrant_ps = nullptr;
-            }
-            else
-            {
-                s[i].PaintStructs[j].basic.next_quadrant_ps = &s[i].PaintStructs
-                                                                   [(uintptr_t)s[i].PaintStructs[j].basic.next_quadrant_ps]
-                                                                       .basic;
-            }
-        }
-        for (size_t j = 0; j < quadrant_entries; j++)
+        do
         {
-            if (s[i].Quadrants[j] == (paint_struct*)quadrant_entries)
+            if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
             {
-                s[i].Quadrants[j] = nullptr;
+                paths.push_back(directory + data.cFileName);
             }
-            else
-            {
-                s[i].Quadrants[j] = &s[i].PaintStructs[(size_t)s[i].Quadrants[j]].basic;
-            }
-        }
+        } while (FindNextFileA(find, &data));
+        FindClose(find);
     }
+    std::sort(paths.begin(), paths.end());
+    return paths;
 }
+#endif
 
-static std::vector<paint_session> extract_paint_session(const char* fname)
+// Captures named by one command line argument: a file, every capture in a directory, or a pattern.
+// Returns nothing for benchmark options and anything else that names no file.
+static std::vector<std::string> expand_capture_argument(const char* arg)
 {
-    FILE* file = fopen(fname, "rb");
-    uLongf cb{};
-    size_t res = fread(&cb, 4, 1, file);
-    if (res != 1) {
-        std::cout << "Invalid read, expected 1 element, got " << res << std::endl;
-        return {};
-    }
-    fseek(file, 0, SEEK_END);
-    uLong fsize = ftell(file) - 4;
-    fseek(file, 4, SEEK_SET);
-    uint32_t org_cb = cb;
-    auto compressedBuffer = std::make_unique<uint8_t[]>(fsize);
-    res = 0;
-    uLong counter = 0;
-    while (res < fsize) {
-        res += fread(compressedBuffer.get() + res, 1, fsize - res, file);
-        if (res < fsize) {
-            std::cout << "incomplete read, so far got " << res << " bytes out of " << fsize << std::endl;
-        }
-        counter++;
-        if (counter > 100) {
-            return {};
-        }
-    }
-    if (res != fsize) {
-        std::cout << "Invalid read, expected " << fsize << " elements, got " << res << std::endl;
-        return {};
-    }
-    fclose(file);
-    auto buffer = std::make_unique<uint8_t[]>(cb);
-    int dcpr_result = uncompress(buffer.get(), &cb, compressedBuffer.get(), fsize);
-    if (cb != org_cb || Z_OK != dcpr_result) {
-        std::cout << "Invalid decompressed size " << cb << ", expected " << org_cb << ", dcpr_result = " << dcpr_result << std::endl;
-        auto stringifier = [dcpr_result](){
-            switch (dcpr_result) {
-                case Z_OK:
-                    return "Z_OK";
-                case Z_MEM_ERROR:
-                    return "Z_MEM_ERROR";
-                case Z_BUF_ERROR:
-                    return "Z_BUF_ERROR";
-                case Z_DATA_ERROR:
-                    return "Z_DATA_ERROR";
-                default:
-                    return "unknown";
-            };
-        };
-        std::cout << "dcpr_result = " << stringifier() << std::endl;
+    if (arg[0] == '-')
+    {
         return {};
     }
-    MemoryStream ms(buffer.get(), cb);
-    std::string version(ms.ReadString());
-    if (version != "paint session v1") {
-        std::cout << "Invalid version: " << version << std::endl;
-        return {};
+    std::error_code error;
+    if (std::filesystem::is_directory(arg, error))
+    {
+        // Not recursive, sorted so every run lists the captures in the same order
+        std::vector<std::string> paths;
+        for (const auto& entry : std::filesystem::directory_iterator(arg, error))
+        {
+            if (entry.is_regular_file(error) && entry.path().extension().string().rfind(".psa", 0) == 0)
+            {
+                paths.push_back(entry.path().string());
+            }
+        }
+        std::sort(paths.begin(), paths.end());
+        return paths;
     }
-    std::string park(ms.ReadString());
-    std::vector<paint_session> sessions = read_sessions(ms);
-    if (ms.GetPosition() != ms.GetLength()) {
-        std::cout << "WARNING: There are " << (ms.GetLength() - ms.GetPosition()) << " leftover bytes. Consumed "
-                  << ms.GetPosition() << " out of " << ms.GetLength() << std::endl;
+    if (platform_file_exists(arg))
+    {
+        return { arg };
     }
-    std::cout << "Park " << park << " has " << sessions.size() << " sessions" << std::endl;
-    return sessions;
+    return std::string(arg).find_first_of("*?[") != std::string::npos ? platform_glob(arg) : std::vector<std::string>{};
 }
 
 static std::string paint_struct_list_to_string(const paint_struct* ps, const paint_struct* base)
@@ -183,23 +153,51 @@ static std::string paint_struct_list_to_string(const paint_struct* ps, const pai
     return result;
 }
 
-static bool verify(const std::vector<paint_session> inputSessions)
+// Returns copies of the structs queued on the session's quadrants, in list order
+static std::vector<paint_struct> collect_paint_structs(const paint_session& session)
+{
+    std::vector<paint_struct> structs;
+    if (session.QuadrantBackIndex != UINT32_MAX)
+    {
+        for (uint32_t quadrant = session.QuadrantBackIndex; quadrant <= session.QuadrantFrontIndex; quadrant++)
+        {
+            for (const paint_struct* ps = session.Quadrants[quadrant]; ps != nullptr; ps = ps->next_quadrant_ps)
+            {
+                structs.push_back(*ps);
+            }
+        }
+    }
+    return structs;
+}
+
+// Submits the structs in the given order and arranges the canonicalised result
+static std::string arrange_submitted(const std::vector<paint_struct>& structs, bool reverse)
+{
+    auto session = std::make_unique<paint_session>();
+    paint_session_submitter submitter(session.get());
+    for (size_t i = 0; i < structs.size(); i++)
+    {
+        submitter.submit(structs[reverse ? structs.size() - 1 - i : i]);
+    }
+    submitter.finish();
+    paint_session_arrange_opt(session.get());
+    return paint_struct_list_to_string(session->PaintHead.next_quadrant_ps, &session->PaintStructs[0].basic);
+}
+
+static bool verify(const paint_corpus& corpus)
 {
     constexpr int session_to_use = 0;
-    std::vector<paint_session> sessions = inputSessions;
-    // Fixing up the pointers continuously is wasteful. Fix it up once for `sessions` and store a copy.
-    // Keep in mind we need bit-exact copy, as the lists use pointers.
-    // Once sorted, just restore the copy with the original fixed-up version.
-    paint_session* local_s = new paint_session[std::size(sessions)];
-    fixup_pointers(&sessions[0], std::size(sessions), std::size(local_s->PaintStructs), std::size(local_s->Quadrants));
-    std::copy_n(sessions.cbegin(), std::size(sessions), local_s);
-    {
-        std::copy_n(local_s, std::size(sessions), sessions.begin());
+    paint_session_set sessions = paint_corpus_checkout(corpus);
+    // Journal the fields arrange mutates and restore them in place before each engine runs.
+    paint_session_journal journal;
+    journal.record(&sessions[0], std::size(sessions));
+    {
+        journal.restore(&sessions[0]);
         paint_session_arrange(&sessions[session_to_use]);
     }
     auto result1 = paint_struct_list_to_string(sessions[session_to_use].PaintHead.next_quadrant_ps, &sessions[session_to_use].PaintStructs[0].basic);
     {
-        std::copy_n(local_s, std::size(sessions), sessions.begin());
+        journal.restore(&sessions[0]);
         paint_session_arrange_opt(&sessions[session_to_use]);
     }
     auto result2 = paint_struct_list_to_string(sessions[session_to_use].PaintHead.next_quadrant_ps, &sessions[session_to_use].PaintStructs[0].basic);
@@ -207,7 +205,7 @@ static bool verify(const std::vector<paint_session> inputSessions)
     std::string result3;
 #if defined(__i386__) || defined(_M_IX86)
     {
-        std::copy_n(local_s, std::size(sessions), sessions.begin());
+        journal.restore(&sessions[0]);
         paint_struct ps;
         RCT2_GLOBAL(0x00EE7888, paint_struct*) = &ps;
         RCT2_GLOBAL(0x00F1AD0C, uint32_t) = sessions[session_to_use].QuadrantBackIndex;
@@ -230,6 +228,12 @@ static bool verify(const std::vector<paint_session> inputSessions)
         std::cout << "error 1" << std::endl;
         ok = false;
     }
+    // Submission order must not leak into the arranged output
+    std::vector<paint_struct> submitted = collect_paint_structs(corpus.sessions[session_to_use]);
+    if (arrange_submitted(submitted, false) != arrange_submitted(submitted, true)) {
+        std::cout << "error 4" << std::endl;
+        ok = false;
+    }
 #if defined(__i386__) || defined(_M_IX86)
     if (result2 != result3) {
         std::cout << "error 2" << std::endl;
@@ -241,168 +245,1466 @@ static bool verify(const std::vector<paint_session> inputSessions)
     }
 #endif
 
-    delete[] local_s;
     return ok;
 }
 
+// Reports how well the arranged draw lists of a corpus collapse into sprite batches
+static void report_batches(const paint_corpus& corpus)
+{
+    paint_session_set sessions = paint_corpus_checkout(corpus);
+    paint_batch_list list;
+    size_t structs = 0;
+    size_t batches = 0;
+    uint32_t longest = 0;
+    for (auto& session : sessions)
+    {
+        paint_session_arrange_opt(&session);
+        paint_session_batch(session, list);
+        structs += list.structs.size();
+        batches += list.batches.size();
+        for (const auto& batch : list.batches)
+        {
+            longest = std::max(longest, batch.count);
+        }
+    }
+    std::cout << "Batching " << corpus.name << ": " << structs << " structs in " << batches << " batches ("
+              << (batches ? (double)structs / batches : 0.0) << " per batch, longest " << longest << ")" << std::endl;
+}
+
+// Bitmap covering every box of an arranged session at the given zoom. Returns false if there is nothing to draw
+// or the bitmap would not fit rct_drawpixelinfo, whose origin and size are all int16_t.
+static bool make_session_bitmap(const paint_session& session, uint16_t zoom, rct_drawpixelinfo& dpi)
+{
+    paint_screen_rect extent;
+    if (!paint_session_screen_extent(session, extent))
+    {
+        return false;
+    }
+    int32_t width = ((extent.right - extent.left) >> zoom) + 1;
+    int32_t height = ((extent.bottom - extent.top) >> zoom) + 1;
+    if (width > INT16_MAX || height > INT16_MAX || extent.left < INT16_MIN || extent.left > INT16_MAX
+        || extent.top < INT16_MIN || extent.top > INT16_MAX)
+    {
+        return false;
+    }
+    dpi = {};
+    dpi.x = (int16_t)extent.left;
+    dpi.y = (int16_t)extent.top;
+    dpi.width = (int16_t)width;
+    dpi.height = (int16_t)height;
+    dpi.zoom_level = zoom;
+    return true;
+}
+
+#ifdef PSA_OPCOUNTERS
+// One row per engine, session and quadrant the engine did any work in
+static void write_op_counts(std::ostream& csv, const paint_corpus& corpus)
+{
+    const struct
+    {
+        const char* name;
+        void (*arrange)(paint_session*);
+    } engines[] = { { "openrct2", paint_session_arrange }, { "opt", paint_session_arrange_opt } };
+    for (const auto& engine : engines)
+    {
+        paint_session_set sessions = paint_corpus_checkout(corpus);
+        for (size_t i = 0; i < std::size(sessions); i++)
+        {
+            paint_arrange_ops.clear();
+            engine.arrange(&sessions[i]);
+            for (size_t quadrant = 0; quadrant < MAX_PAINT_QUADRANTS; quadrant++)
+            {
+                const paint_arrange_op_counts& ops = paint_arrange_ops.quadrants[quadrant];
+                if (ops.walk_steps != 0)
+                {
+                    csv << corpus.name << ',' << engine.name << ',' << i << ',' << quadrant << ',' << ops.walk_steps << ','
+                        << ops.bbox_checks << ',' << ops.bbox_true << ',' << ops.flag_passes << '\n';
+                }
+            }
+        }
+    }
+    csv.flush();
+}
+#endif
 
 #ifdef WITH_BENCHMARK
-static void BM_paint_session_arrange(benchmark::State& state, const std::vector<paint_session> inputSessions)
-{
-    std::vector<paint_session> sessions = inputSessions;
-    // Fixing up the pointers continuously is wasteful. Fix it up once for `sessions` and store a copy.
-    // Keep in mind we need bit-exact copy, as the lists use pointers.
-    // Once sorted, just restore the copy with the original fixed-up version.
-    paint_session* local_s = new paint_session[std::size(sessions)];
-    fixup_pointers(&sessions[0], std::size(sessions), std::size(local_s->PaintStructs), std::size(local_s->Quadrants));
-    std::copy_n(sessions.cbegin(), std::size(sessions), local_s);
+// Sessions per generated scene, each from its own seed
+constexpr size_t synthetic_sessions = 4;
+// Distinct sessions remembered by the cached arrange benchmark
+constexpr size_t arrange_cache_capacity = 64;
+// Iterations the latency benchmark keeps timings of for every session, a uniform sample of all of them
+constexpr size_t latency_samples_per_session = 64;
+
+// Benchmarks load their capture when they first run, so filtered out captures are never decoded
+static paint_corpus_ptr acquire_corpus(benchmark::State& state, paint_corpus_source& source)
+{
+    paint_corpus_ptr corpus = source.get();
+    if (corpus == nullptr)
+    {
+        state.SkipWithError(("Invalid capture " + source.name()).c_str());
+    }
+    return corpus;
+}
+
+// Reports hardware counts per arranged session, the counters only ran around the arrange calls themselves
+static void report_perf_counters(benchmark::State& state, const paint_perf_counters& counters, size_t sessions)
+{
+    if (!counters.available())
+    {
+        static bool reported = false;
+        if (!reported)
+        {
+            std::cout << "Hardware counters unavailable (" << counters.error() << ")" << std::endl;
+            reported = true;
+        }
+        return;
+    }
+    double items = (double)state.iterations() * sessions;
+    for (const auto& [name, count] : counters.read())
+    {
+        state.counters[name] = count / items;
+    }
+    if (state.counters.count("cycles") != 0 && state.counters.count("instructions") != 0 && state.counters["cycles"] > 0)
+    {
+        state.counters["ipc"] = state.counters["instructions"] / state.counters["cycles"];
+    }
+}
+
+// Reports `ticks` spent on `stretches` timed stretches as the iteration time, less what reading the clock cost
+static void set_iteration_ticks(benchmark::State& state, uint64_t ticks, size_t stretches)
+{
+    uint64_t overhead = paint_ticks_overhead() * stretches;
+    state.SetIterationTime((ticks > overhead ? ticks - overhead : 0) * paint_tick_ns() * 1e-9);
+}
+
+// Operation counts per arranged session, only instrumented builds have any
+static void report_op_counts([[maybe_unused]] benchmark::State& state, [[maybe_unused]] size_t sessions)
+{
+#ifdef PSA_OPCOUNTERS
+    paint_arrange_op_counts total = paint_arrange_ops.total();
+    double items = (double)state.iterations() * sessions;
+    state.counters["walk_steps"] = total.walk_steps / items;
+    state.counters["bbox_checks"] = total.bbox_checks / items;
+    state.counters["bbox_true"] = total.bbox_true / items;
+    state.counters["flag_passes"] = total.flag_passes / items;
+#endif
+}
+
+static void BM_paint_session_arrange(benchmark::State& state, paint_corpus_source_ptr source)
+{
+    paint_corpus_ptr corpus = acquire_corpus(state, *source);
+    if (corpus == nullptr)
+    {
+        return;
+    }
+    // The corpus is shared between benchmarks, only the working copy is ours to arrange.
+    // Once sorted, just restore the journaled fields in place, the lists keep pointing into `sessions`.
+    paint_session_set sessions = paint_corpus_checkout(*corpus);
+    paint_session_journal journal;
+    journal.record(&sessions[0], std::size(sessions));
+    paint_perf_counters counters;
+#ifdef PSA_OPCOUNTERS
+    paint_arrange_ops.clear();
+#endif
+    // Manually timed, so restoring is left out without pausing the benchmark's own timer
     for (auto _ : state)
     {
-        state.PauseTiming();
-        std::copy_n(local_s, std::size(sessions), sessions.begin());
-        for (int i = 0; i < std::size(sessions); i++) {
-            // Provide fair conditions for vanilla and pause like it pauses
-            state.PauseTiming();
-            state.ResumeTiming();
-            paint_session_arrange(&sessions[i]);
+        journal.restore(&sessions[0]);
+        counters.start();
+        uint64_t begin = paint_ticks_begin();
+        for (auto& session : sessions)
+        {
+            paint_session_arrange(&session);
         }
+        uint64_t end = paint_ticks_end();
+        counters.stop();
+        set_iteration_ticks(state, end - begin, 1);
         benchmark::DoNotOptimize(sessions);
     }
     state.SetItemsProcessed(state.iterations() * std::size(sessions));
-    delete[] local_s;
+    report_perf_counters(state, counters, std::size(sessions));
+    report_op_counts(state, std::size(sessions));
 }
 
-static void BM_paint_session_arrange_opt(benchmark::State& state, const std::vector<paint_session> inputSessions)
+static void BM_paint_session_arrange_opt(benchmark::State& state, paint_corpus_source_ptr source)
 {
-    std::vector<paint_session> sessions = inputSessions;
-    // Fixing up the pointers continuously is wasteful. Fix it up once for `sessions` and store a copy.
-    // Keep in mind we need bit-exact copy, as the lists use pointers.
-    // Once sorted, just restore the copy with the original fixed-up version.
-    paint_session* local_s = new paint_session[std::size(sessions)];
-    fixup_pointers(&sessions[0], std::size(sessions), std::size(local_s->PaintStructs), std::size(local_s->Quadrants));
-    std::copy_n(sessions.cbegin(), std::size(sessions), local_s);
+    paint_corpus_ptr corpus = acquire_corpus(state, *source);
+    if (corpus == nullptr)
+    {
+        return;
+    }
+    // The corpus is shared between benchmarks, only the working copy is ours to arrange.
+    // Once sorted, just restore the journaled fields in place, the lists keep pointing into `sessions`.
+    paint_session_set sessions = paint_corpus_checkout(*corpus);
+    paint_session_journal journal;
+    journal.record(&sessions[0], std::size(sessions));
+    paint_perf_counters counters;
+#ifdef PSA_OPCOUNTERS
+    paint_arrange_ops.clear();
+#endif
+    // Manually timed, so restoring is left out without pausing the benchmark's own timer
     for (auto _ : state)
     {
-        state.PauseTiming();
-        std::copy_n(local_s, std::size(sessions), sessions.begin());
-        for (int i = 0; i < std::size(sessions); i++) {
-            // Provide fair conditions for vanilla and pause like it pauses
-            state.PauseTiming();
-            state.ResumeTiming();
-            paint_session_arrange_opt(&sessions[i]);
+        journal.restore(&sessions[0]);
+        counters.start();
+        uint64_t begin = paint_ticks_begin();
+        for (auto& session : sessions)
+        {
+            paint_session_arrange_opt(&session);
         }
+        uint64_t end = paint_ticks_end();
+        counters.stop();
+        set_iteration_ticks(state, end - begin, 1);
         benchmark::DoNotOptimize(sessions);
     }
     state.SetItemsProcessed(state.iterations() * std::size(sessions));
-    delete[] local_s;
+    report_perf_counters(state, counters, std::size(sessions));
+    report_op_counts(state, std::size(sessions));
 }
 
-#if defined(__i386__) || defined(_M_IX86)
-// Based a lot on https://github.com/OpenRCT2/OpenRCT2/commit/d6fd03070268a21547f18bec8a0c87abcf30eef2
-static void BM_paint_session_arrange_vanilla(benchmark::State& state, const std::vector<paint_session> inputSessions)
-{
-    std::vector<paint_session> sessions = inputSessions;
-    // Fixing up the pointers continuously is wasteful. Fix it up once for `sessions` and store a copy.
-    // Keep in mind we need bit-exact copy, as the lists use pointers.
-    // Once sorted, just restore the copy with the original fixed-up version.
-    paint_session* local_s = new paint_session[std::size(sessions)];
-    fixup_pointers(&sessions[0], std::size(sessions), std::size(local_s->PaintStructs), std::size(local_s->Quadrants));
-    std::copy_n(sessions.cbegin(), std::size(sessions), local_s);
+enum class cache_disturbance
+{
+    // As if paint generation had run since, see paint_cache_evict()
+    evict,
+    // Every line of the session flushed out to memory
+    flush,
+};
+
+// Opt arrange starting from disturbed caches, the warm counterpart is BM_paint_session_arrange_opt
+static void BM_paint_session_arrange_cold(
+    benchmark::State& state, paint_corpus_source_ptr source, cache_disturbance disturbance)
+{
+    paint_corpus_ptr corpus = acquire_corpus(state, *source);
+    if (corpus == nullptr)
+    {
+        return;
+    }
+    paint_session_set sessions = paint_corpus_checkout(*corpus);
+    paint_session_journal journal;
+    journal.record(&sessions[0], std::size(sessions));
+    paint_perf_counters counters;
     for (auto _ : state)
     {
-        state.PauseTiming();
-        std::copy_n(local_s, std::size(sessions), sessions.begin());
-        for (int i = 0; i < std::size(sessions); i++) {
-            state.PauseTiming();
-            paint_struct ps;
-            RCT2_GLOBAL(0x00EE7888, paint_struct*) = &ps;
-            RCT2_GLOBAL(0x00F1AD0C, uint32_t) = sessions[i].QuadrantBackIndex;
-            RCT2_GLOBAL(0x00F1AD10, uint32_t) = sessions[i].QuadrantFrontIndex;
-            RCT2_GLOBAL(0x00EE7880, paint_entry *) = &sessions[i].PaintStructs[4000 - 1];
-            memcpy(RCT2_ADDRESS(0x00F1A50C, paint_struct), &sessions[i].Quadrants[0], 512 * sizeof(paint_struct *));
-            // Not actually required, as the code only iterates over the pointees from quadrants.
-            //memcpy(RCT2_ADDRESS(0x00EE788C, paint_struct), &sessions[i].PaintStructs[0].basic, 4000 * sizeof(paint_struct));
-            RCT2_GLOBAL(0x00EE7884, paint_struct*) = nullptr;
-            RCT2_GLOBAL(RCT2_ADDRESS_CURRENT_ROTATION, uint32_t) = sessions[i].CurrentRotation;
-            state.ResumeTiming();
-            RCT2_CALLPROC_X(0x688217, 0, 0, 0, 0, 0, 0, 0);
+        journal.restore(&sessions[0]);
+        uint64_t ticks = 0;
+        for (auto& session : sessions)
+        {
+            if (disturbance == cache_disturbance::flush)
+            {
+                paint_cache_flush(&session, sizeof(session));
+            }
+            else
+            {
+                paint_cache_evict();
+            }
+            counters.start();
+            uint64_t begin = paint_ticks_begin();
+            paint_session_arrange_opt(&session);
+            ticks += paint_ticks_end() - begin;
+            counters.stop();
         }
+        set_iteration_ticks(state, ticks, std::size(sessions));
         benchmark::DoNotOptimize(sessions);
     }
     state.SetItemsProcessed(state.iterations() * std::size(sessions));
-    delete[] local_s;
+    report_perf_counters(state, counters, std::size(sessions));
 }
 
-static void fixup()
+// Times every session on its own: a few slow frames are what players notice, the average hides them
+static void BM_paint_session_arrange_latency(benchmark::State& state, paint_corpus_source_ptr source)
 {
-#ifdef __linux
-    const char * segments = (char *)(0x401000);
-    int err = mprotect((void *)0x401000, 0x8a4000 - 0x401000, PROT_READ | PROT_EXEC);
-	if (err != 0)
-	{
-		perror("mprotect");
-	}
-	// section: rw data
-	err = mprotect((void *)0x8a4000, 0x01429000 - 0x8a4000, PROT_READ | PROT_WRITE);
-	if (err != 0)
-	{
-		perror("mprotect");
-	}
-#endif
+    paint_corpus_ptr corpus = acquire_corpus(state, *source);
+    if (corpus == nullptr)
+    {
+        return;
+    }
+    paint_session_set sessions = paint_corpus_checkout(*corpus);
+    paint_session_journal journal;
+    journal.record(&sessions[0], std::size(sessions));
+    size_t count = std::size(sessions);
+    // Reservoir sample of the iterations, the same ones for every session: sample k of session i at k * count + i
+    std::vector<uint64_t> ticks(latency_samples_per_session * count);
+    std::mt19937 random(0);
+    size_t iterations = 0;
+    for (auto _ : state)
+    {
+        journal.restore(&sessions[0]);
+        size_t slot = iterations < latency_samples_per_session ? iterations : random() % (iterations + 1);
+        uint64_t* sample = slot < latency_samples_per_session ? &ticks[slot * count] : nullptr;
+        uint64_t total = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            uint64_t begin = paint_ticks_begin();
+            paint_session_arrange_opt(&sessions[i]);
+            uint64_t elapsed = paint_ticks_end() - begin;
+            if (sample != nullptr)
+            {
+                sample[i] = elapsed;
+            }
+            total += elapsed;
+        }
+        set_iteration_ticks(state, total, count);
+        benchmark::DoNotOptimize(sessions);
+        iterations++;
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    if (iterations == 0)
+    {
+        return;
+    }
+    size_t kept = std::min(iterations, latency_samples_per_session);
+    ticks.resize(kept * count);
+
+    // Slowest sessions by their median over the sampled iterations, so one unlucky interrupt does not make the list
+    std::vector<uint64_t> medians(count);
+    std::vector<uint64_t> samples(kept);
+    for (size_t i = 0; i < count; i++)
+    {
+        for (size_t k = 0; k < kept; k++)
+        {
+            samples[k] = ticks[k * count + i];
+        }
+        std::nth_element(samples.begin(), samples.begin() + kept / 2, samples.end());
+        medians[i] = samples[kept / 2];
+    }
+    std::vector<uint32_t> slowest(count);
+    std::iota(slowest.begin(), slowest.end(), 0);
+    size_t reported = std::min<size_t>(5, count);
+    std::partial_sort(slowest.begin(), slowest.begin() + reported, slowest.end(),
+        [&medians](uint32_t a, uint32_t b) { return medians[a] > medians[b]; });
+    std::string label = "slowest";
+    for (size_t i = 0; i < reported; i++)
+    {
+        label += " " + std::to_string(slowest[i]);
+    }
+    state.SetLabel(label);
+
+    std::sort(ticks.begin(), ticks.end());
+    uint64_t overhead = std::min(paint_ticks_overhead(), ticks.front());
+    for (auto& sample : ticks)
+    {
+        sample -= overhead;
+    }
+    double us = paint_tick_ns() / 1000;
+    auto percentile = [&ticks, us](double p) { return ticks[std::min(ticks.size() - 1, (size_t)(p * ticks.size()))] * us; };
+    state.counters["min_us"] = ticks.front() * us;
+    state.counters["p50_us"] = percentile(0.50);
+    state.counters["p90_us"] = percentile(0.90);
+    state.counters["p99_us"] = percentile(0.99);
+    state.counters["max_us"] = ticks.back() * us;
 }
-#else
-static void fixup() {}
-#endif
 
-int main_psa(int argc, char* argv[])
+// Arrange through a cache that starts out empty every iteration, so only repeats within the capture hit
+static void BM_paint_session_arrange_cached(benchmark::State& state, paint_corpus_source_ptr source)
 {
-    fixup();
+    paint_corpus_ptr corpus = acquire_corpus(state, *source);
+    if (corpus == nullptr)
     {
-        // Register some basic "baseline" benchmark
-        std::vector<paint_session> sessions(1);
-        for (auto& ps : sessions[0].PaintStructs)
+        return;
+    }
+    paint_session_set sessions = paint_corpus_checkout(*corpus);
+    paint_session_journal journal;
+    journal.record(&sessions[0], std::size(sessions));
+    paint_arrange_cache cache(arrange_cache_capacity);
+    size_t hits = 0;
+    for (auto _ : state)
+    {
+        journal.restore(&sessions[0]);
+        cache.clear();
+        uint64_t begin = paint_ticks_begin();
+        for (auto& session : sessions)
+        {
+            cache.arrange(&session);
+        }
+        set_iteration_ticks(state, paint_ticks_end() - begin, 1);
+        hits += cache.hits();
+        benchmark::DoNotOptimize(sessions);
+    }
+    state.SetItemsProcessed(state.iterations() * std::size(sessions));
+    state.counters["hit_rate"] = (double)hits / (state.iterations() * std::size(sessions));
+    state.counters["unique"] = (double)corpus->sessions.unique_size();
+}
+
+// Generation, arrange and drawing of every session, timed per stage
+static void BM_paint_session_frame(benchmark::State& state, paint_corpus_source_ptr source)
+{
+    paint_corpus_ptr corpus = acquire_corpus(state, *source);
+    if (corpus == nullptr)
+    {
+        return;
+    }
+    paint_session_set sessions = paint_corpus_checkout(*corpus);
+    std::vector<paint_frame_input> inputs(std::size(sessions));
+    for (size_t i = 0; i < std::size(sessions); i++)
+    {
+        paint_frame_record(sessions[i], inputs[i]);
+    }
+    uint64_t generate = 0;
+    uint64_t arrange = 0;
+    uint64_t draw = 0;
+    uint32_t checksum = 0;
+    for (auto _ : state)
+    {
+        uint64_t stages[4];
+        uint64_t total = 0;
+        for (size_t i = 0; i < std::size(sessions); i++)
         {
-            ps.basic.next_quadrant_ps = (paint_struct*)(std::size(sessions[0].PaintStructs));
+            // Each boundary ends one stage and starts the next, which paint_ticks_end() fences for on both sides
+            stages[0] = paint_ticks_begin();
+            paint_frame_generate(sessions[i], inputs[i]);
+            stages[1] = paint_ticks_end();
+            paint_session_arrange_opt(&sessions[i]);
+            stages[2] = paint_ticks_end();
+            checksum += paint_frame_draw(sessions[i]);
+            stages[3] = paint_ticks_end();
+            generate += stages[1] - stages[0];
+            arrange += stages[2] - stages[1];
+            draw += stages[3] - stages[2];
+            total += stages[3] - stages[0];
         }
-        for (auto& quad : sessions[0].Quadrants)
+        set_iteration_ticks(state, total, std::size(sessions));
+    }
+    benchmark::DoNotOptimize(checksum);
+    double items = (double)state.iterations() * std::size(sessions);
+    double us = paint_tick_ns() / 1000;
+    state.SetItemsProcessed(state.iterations() * std::size(sessions));
+    state.counters["generate_us"] = generate * us / items;
+    state.counters["arrange_us"] = arrange * us / items;
+    state.counters["draw_us"] = draw * us / items;
+}
+
+// Arrange of generated scenes: structs, quadrants, overlap and rotation come from the arguments
+static void BM_paint_scene_arrange(
+    benchmark::State& state, paint_scene_options options, void (*arrange)(paint_session*))
+{
+    options.structs = (uint32_t)state.range(0);
+    options.quadrants = (uint32_t)state.range(1);
+    options.overlap = (uint32_t)state.range(2);
+    options.rotation = (uint8_t)state.range(3);
+    paint_corpus_ptr corpus = paint_scene_generate(options, synthetic_sessions);
+    if (corpus == nullptr)
+    {
+        state.SkipWithError("Scene options out of range");
+        return;
+    }
+    paint_session_set sessions = paint_corpus_checkout(*corpus);
+    paint_session_journal journal;
+    journal.record(&sessions[0], std::size(sessions));
+#ifdef PSA_OPCOUNTERS
+    paint_arrange_ops.clear();
+#endif
+    for (auto _ : state)
+    {
+        journal.restore(&sessions[0]);
+        uint64_t begin = paint_ticks_begin();
+        for (auto& session : sessions)
         {
-            quad = (paint_struct*)(std::size(sessions[0].Quadrants));
+            arrange(&session);
         }
-        benchmark::RegisterBenchmark("baseline", BM_paint_session_arrange, sessions);
+        set_iteration_ticks(state, paint_ticks_end() - begin, 1);
+        benchmark::DoNotOptimize(sessions);
     }
+    state.SetItemsProcessed(state.iterations() * std::size(sessions));
+    report_op_counts(state, std::size(sessions));
+}
 
-    std::vector<char*> argv_for_benchmark;
+enum class paint_sweep
+{
+    // The first k quadrants of each session, at their original density
+    quadrants,
+    // k structs spread evenly over each session, thinning it out
+    structs,
+};
 
-    argv_for_benchmark.push_back(argv[0]);
+static void truncate_quadrants(paint_session& session, uint32_t count)
+{
+    if (session.QuadrantBackIndex != UINT32_MAX)
+    {
+        session.QuadrantFrontIndex = std::min(session.QuadrantFrontIndex, session.QuadrantBackIndex + count - 1);
+    }
+}
 
-    // Extract file names from argument list. If there is no such file, consider it benchmark option.
-    for (int i = 1; i < argc; i++)
+// Unlinks all but `count` structs, keeping list order
+static void subsample_structs(paint_session& session, uint32_t count)
+{
+    size_t total = collect_paint_structs(session).size();
+    if (total <= count)
     {
-        if (platform_file_exists(argv[i]))
+        return;
+    }
+    size_t index = 0;
+    for (uint32_t quadrant = session.QuadrantBackIndex; quadrant <= session.QuadrantFrontIndex; quadrant++)
+    {
+        paint_struct* ps = session.Quadrants[quadrant];
+        paint_struct* last = nullptr;
+        session.Quadrants[quadrant] = nullptr;
+        while (ps != nullptr)
         {
-            // Register benchmark for sv6 if valid
-            std::vector<paint_session> sessions = extract_paint_session(argv[i]);
-            if (!sessions.empty())
+            paint_struct* next = ps->next_quadrant_ps;
+            // Struct `index` is kept when it starts a new one of `count` equal shares
+            if ((index + 1) * count / total != index * count / total)
             {
-                if (!verify(sessions))
+                if (last == nullptr)
                 {
-                    //return 1;
+                    session.Quadrants[quadrant] = ps;
                 }
-                std::string name(argv[i]);
-                benchmark::RegisterBenchmark(name.c_str(), BM_paint_session_arrange, sessions);
-                std::string name_opt = name + "_opt";
-                benchmark::RegisterBenchmark(name_opt.c_str(), BM_paint_session_arrange_opt, sessions);
-#if defined(__i386__) || defined(_M_IX86)
-                name += " vanilla";
-                benchmark::RegisterBenchmark(name.c_str(), BM_paint_session_arrange_vanilla, sessions);
-#endif
+                else
+                {
+                    last->next_quadrant_ps = ps;
+                }
+                last = ps;
             }
+            index++;
+            ps = next;
+        }
+        if (last != nullptr)
+        {
+            last->next_quadrant_ps = nullptr;
+        }
+    }
+}
+
+// Arrange over sessions cut down to k quadrants or k structs, with the structs left per session as complexity N.
+// `prepare` runs untimed before every session, for engines that need setting up.
+static void BM_paint_session_sweep(benchmark::State& state, paint_corpus_source_ptr source, paint_sweep sweep,
+    void (*prepare)(paint_session*), void (*arrange)(paint_session*))
+{
+    paint_corpus_ptr corpus = acquire_corpus(state, *source);
+    if (corpus == nullptr)
+    {
+        return;
+    }
+    paint_session_set sessions = paint_corpus_checkout(*corpus);
+    size_t structs = 0;
+    for (auto& session : sessions)
+    {
+        if (sweep == paint_sweep::quadrants)
+        {
+            truncate_quadrants(session, (uint32_t)state.range(0));
         }
         else
         {
-            argv_for_benchmark.push_back((char*)argv[i]);
+            subsample_structs(session, (uint32_t)state.range(0));
+        }
+        structs += collect_paint_structs(session).size();
+    }
+    paint_session_journal journal;
+    journal.record(&sessions[0], std::size(sessions));
+    for (auto _ : state)
+    {
+        journal.restore(&sessions[0]);
+        uint64_t ticks = 0;
+        for (auto& session : sessions)
+        {
+            if (prepare != nullptr)
+            {
+                prepare(&session);
+            }
+            uint64_t begin = paint_ticks_begin();
+            arrange(&session);
+            ticks += paint_ticks_end() - begin;
         }
+        set_iteration_ticks(state, ticks, std::size(sessions));
+        benchmark::DoNotOptimize(sessions);
+    }
+    state.SetItemsProcessed(state.iterations() * structs);
+    // Per session, as each is arranged on its own: the fit then reads as the cost of one frame's worth of sessions
+    state.SetComplexityN((int64_t)(structs / std::max<size_t>(1, std::size(sessions))));
+}
+
+// Arrange over every session turned to camera rotation range(0), see paint_session_rotate().
+// `prepare` runs untimed before every session, for engines that need setting up.
+static void BM_paint_session_rotation(benchmark::State& state, paint_corpus_source_ptr source,
+    void (*prepare)(paint_session*), void (*arrange)(paint_session*))
+{
+    paint_corpus_ptr corpus = acquire_corpus(state, *source);
+    if (corpus == nullptr)
+    {
+        return;
     }
+    paint_corpus_ptr rotated = paint_corpus_rotate(*corpus, (uint8_t)state.range(0));
+    paint_session_set sessions = paint_corpus_checkout(*rotated);
+    paint_session_journal journal;
+    journal.record(&sessions[0], std::size(sessions));
+    for (auto _ : state)
+    {
+        journal.restore(&sessions[0]);
+        uint64_t ticks = 0;
+        for (auto& session : sessions)
+        {
+            if (prepare != nullptr)
+            {
+                prepare(&session);
+            }
+            uint64_t begin = paint_ticks_begin();
+            arrange(&session);
+            ticks += paint_ticks_end() - begin;
+        }
+        set_iteration_ticks(state, ticks, std::size(sessions));
+        benchmark::DoNotOptimize(sessions);
+    }
+    state.SetItemsProcessed(state.iterations() * std::size(sessions));
+}
+
+// Box rasteriser over sessions arranged once up front, each drawn into a cleared bitmap that covers it
+static void BM_paint_session_raster(benchmark::State& state, paint_corpus_source_ptr source)
+{
+    paint_corpus_ptr corpus = acquire_corpus(state, *source);
+    if (corpus == nullptr)
+    {
+        return;
+    }
+    paint_session_set sessions = paint_corpus_checkout(*corpus);
+    std::vector<std::pair<const paint_session*, rct_drawpixelinfo>> drawable;
+    size_t largest = 0;
+    size_t structs = 0;
+    for (auto& session : sessions)
+    {
+        // Counted before arranging, which chains every quadrant list into one
+        size_t count = collect_paint_structs(session).size();
+        paint_session_arrange_opt(&session);
+        rct_drawpixelinfo dpi;
+        if (make_session_bitmap(session, (uint16_t)state.range(0), dpi))
+        {
+            drawable.emplace_back(&session, dpi);
+            largest = std::max(largest, (size_t)dpi.width * dpi.height);
+            structs += count;
+        }
+    }
+    std::vector<uint8_t> bits(largest);
+    size_t pixels = 0;
+    for (auto _ : state)
+    {
+        uint64_t ticks = 0;
+        for (auto& [session, dpi] : drawable)
+        {
+            std::memset(bits.data(), 0, (size_t)dpi.width * dpi.height);
+            dpi.bits = bits.data();
+            uint64_t begin = paint_ticks_begin();
+            pixels += paint_session_rasterise(*session, dpi);
+            ticks += paint_ticks_end() - begin;
+        }
+        set_iteration_ticks(state, ticks, std::size(drawable));
+        benchmark::DoNotOptimize(bits.data());
+    }
+    state.SetItemsProcessed(state.iterations() * structs);
+    state.counters["pixels_per_second"] = benchmark::Counter((double)pixels, benchmark::Counter::kIsRate);
+}
+
+// Batching pass alone, over sessions arranged once up front
+static void BM_paint_session_batch(benchmark::State& state, paint_corpus_source_ptr source)
+{
+    paint_corpus_ptr corpus = acquire_corpus(state, *source);
+    if (corpus == nullptr)
+    {
+        return;
+    }
+    paint_session_set sessions = paint_corpus_checkout(*corpus);
+    for (auto& session : sessions)
+    {
+        paint_session_arrange_opt(&session);
+    }
+    paint_batch_list list;
+    size_t structs = 0;
+    size_t batches = 0;
+    for (auto _ : state)
+    {
+        for (const auto& session : sessions)
+        {
+            paint_session_batch(session, list);
+            structs += list.structs.size();
+            batches += list.batches.size();
+        }
+        benchmark::DoNotOptimize(list);
+    }
+    state.SetItemsProcessed(structs);
+    state.counters["structs_per_batch"] = batches ? (double)structs / batches : 0.0;
+}
+
+// Multi-producer submission into a single session, each producer takes an equal share of every session's structs.
+// The calling thread is producer 0, the others wait for the next round on `generation`.
+static void BM_paint_session_submit(benchmark::State& state, paint_corpus_source_ptr source)
+{
+    paint_corpus_ptr corpus = acquire_corpus(state, *source);
+    if (corpus == nullptr)
+    {
+        return;
+    }
+    const int producers = (int)state.range(0);
+    std::vector<std::vector<paint_struct>> inputs;
+    size_t struct_count = 0;
+    for (const auto& session : corpus->sessions)
+    {
+        inputs.push_back(collect_paint_structs(session));
+        struct_count += inputs.back().size();
+    }
+    auto session = std::make_unique<paint_session>();
+    paint_session_submitter submitter(session.get());
+
+    size_t current = 0;
+    std::atomic<uint32_t> generation{ 0 };
+    std::atomic<int> pending{ 0 };
+    std::atomic<bool> stop{ false };
+    auto produce = [&](int producer) {
+        const auto& structs = inputs[current];
+        size_t begin = structs.size() * producer / producers;
+        size_t end = structs.size() * (producer + 1) / producers;
+        for (size_t i = begin; i < end; i++)
+        {
+            submitter.submit(structs[i]);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int producer = 1; producer < producers; producer++)
+    {
+        threads.emplace_back([&, producer]() {
+            uint32_t seen = 0;
+            while (true)
+            {
+                uint32_t next;
+                while ((next = generation.load(std::memory_order_acquire)) == seen)
+                {
+                    if (stop.load(std::memory_order_acquire))
+                        return;
+                    std::this_thread::yield();
+                }
+                seen = next;
+                produce(producer);
+                pending.fetch_sub(1, std::memory_order_release);
+            }
+        });
+    }
+
+    for (auto _ : state)
+    {
+        for (current = 0; current < std::size(inputs); current++)
+        {
+            pending.store(producers - 1, std::memory_order_relaxed);
+            generation.fetch_add(1, std::memory_order_release);
+            produce(0);
+            while (pending.load(std::memory_order_acquire) != 0)
+            {
+                std::this_thread::yield();
+            }
+            submitter.finish();
+        }
+        benchmark::DoNotOptimize(*session);
+    }
+    stop.store(true, std::memory_order_release);
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    state.SetItemsProcessed(state.iterations() * struct_count);
+}
+
+static void BM_paint_corpus_load(benchmark::State& state, std::string fname)
+{
+    paint_corpus_load_options options;
+    options.threads = (unsigned)state.range(0);
+    options.verbose = false;
+    size_t sessions = 0;
+    double validation_ms = 0;
+    for (auto _ : state)
+    {
+        paint_corpus_ptr corpus = paint_corpus_load(fname.c_str(), options);
+        if (corpus == nullptr)
+        {
+            state.SkipWithError(("Invalid capture " + fname).c_str());
+            break;
+        }
+        sessions = std::size(corpus->sessions);
+        validation_ms += corpus->link_validation_ms;
+        benchmark::DoNotOptimize(corpus);
+    }
+    // Included in the load time, reported on its own as it is the same for every format
+    state.counters["validate_ms"] = benchmark::Counter(validation_ms, benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations() * sessions);
+    // In v1 record bytes, so throughput compares across capture formats
+    state.SetBytesProcessed(state.iterations() * sessions * paint_session_record_size);
+}
+
+// Decoding alone: v1 records already in memory, no inflate
+static void BM_paint_session_decode(benchmark::State& state, paint_corpus_source_ptr source)
+{
+    paint_corpus_ptr corpus = acquire_corpus(state, *source);
+    if (corpus == nullptr)
+    {
+        return;
+    }
+    MemoryStream records;
+    for (const auto& session : corpus->sessions)
+    {
+        paint_sessions_write_records(records, &session, 1);
+    }
+    std::vector<paint_session> sessions(std::size(corpus->sessions));
+    for (auto _ : state)
+    {
+        MemoryStream ms(records.GetData(), records.GetLength());
+        paint_sessions_read_records(ms, &sessions[0], std::size(sessions));
+        benchmark::DoNotOptimize(sessions.data());
+    }
+    state.SetBytesProcessed(state.iterations() * records.GetLength());
+}
+
+// Random access: how long it takes to get at the last session of a capture
+static void BM_paint_corpus_load_session(benchmark::State& state, std::string fname, size_t index)
+{
+    for (auto _ : state)
+    {
+        auto session = paint_corpus_load_session(fname.c_str(), index);
+        if (session == nullptr)
+        {
+            state.SkipWithError(("Invalid capture " + fname).c_str());
+            break;
+        }
+        benchmark::DoNotOptimize(session);
+    }
+}
+
+// Loaded corpora waiting for the consumer per loading thread: enough to ride out one slow capture
+constexpr size_t pipeline_depth_per_thread = 2;
+
+// Every capture streamed through the load pipeline with nothing else to do, in sessions/s over all of them
+static void BM_paint_corpus_load_all(benchmark::State& state, std::vector<std::string> files)
+{
+    unsigned threads = (unsigned)state.range(0);
+    size_t sessions = 0;
+    size_t invalid = 0;
+    for (auto _ : state)
+    {
+        paint_corpus_pipeline pipeline(files, threads, threads * pipeline_depth_per_thread);
+        paint_corpus_ptr corpus;
+        while (pipeline.next(corpus))
+        {
+            sessions += corpus != nullptr ? std::size(corpus->sessions) : 0;
+            invalid += corpus == nullptr;
+        }
+    }
+    state.SetItemsProcessed(sessions);
+    state.SetBytesProcessed(sessions * paint_session_record_size);
+    state.counters["invalid"] = benchmark::Counter((double)invalid, benchmark::Counter::kAvgIterations);
+}
+
+// Arranges every session of every capture while the pipeline loads the next ones in the background.
+// Waiting for a capture and checking it out are not timed, so this is arrange throughput with loading alongside.
+// Manually timed around each capture's arrange loop, Pause/ResumeTiming cost more than a small capture takes.
+static void BM_paint_corpus_arrange_all(benchmark::State& state, std::vector<std::string> files)
+{
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t sessions = 0;
+    for (auto _ : state)
+    {
+        uint64_t ticks = 0;
+        size_t stretches = 0;
+        paint_corpus_pipeline pipeline(files, threads, threads * pipeline_depth_per_thread);
+        paint_corpus_ptr corpus;
+        while (pipeline.next(corpus))
+        {
+            if (corpus == nullptr)
+            {
+                continue;
+            }
+            paint_session_set working = paint_corpus_checkout(*corpus);
+            uint64_t begin = paint_ticks_begin();
+            for (auto& session : working)
+            {
+                paint_session_arrange_opt(&session);
+            }
+            ticks += paint_ticks_end() - begin;
+            stretches++;
+            sessions += std::size(working);
+        }
+        set_iteration_ticks(state, ticks, stretches);
+    }
+    state.SetItemsProcessed(sessions);
+}
+
+#if defined(__i386__) || defined(_M_IX86)
+// Points the game's arrange globals at `session`. The game arranges into its own head struct, which lives on here.
+static void vanilla_prepare(paint_session* session)
+{
+    static paint_struct ps;
+    RCT2_GLOBAL(0x00EE7888, paint_struct*) = &ps;
+    RCT2_GLOBAL(0x00F1AD0C, uint32_t) = session->QuadrantBackIndex;
+    RCT2_GLOBAL(0x00F1AD10, uint32_t) = session->QuadrantFrontIndex;
+    RCT2_GLOBAL(0x00EE7880, paint_entry *) = &session->PaintStructs[4000 - 1];
+    memcpy(RCT2_ADDRESS(0x00F1A50C, paint_struct), &session->Quadrants[0], 512 * sizeof(paint_struct *));
+    // Not actually required, as the code only iterates over the pointees from quadrants.
+    //memcpy(RCT2_ADDRESS(0x00EE788C, paint_struct), &session->PaintStructs[0].basic, 4000 * sizeof(paint_struct));
+    RCT2_GLOBAL(0x00EE7884, paint_struct*) = nullptr;
+    RCT2_GLOBAL(RCT2_ADDRESS_CURRENT_ROTATION, uint32_t) = session->CurrentRotation;
+}
+
+// Arranges whatever vanilla_prepare() last pointed the globals at
+static void vanilla_arrange(paint_session*)
+{
+    RCT2_CALLPROC_X(0x688217, 0, 0, 0, 0, 0, 0, 0);
+}
+
+// Based a lot on https://github.com/OpenRCT2/OpenRCT2/commit/d6fd03070268a21547f18bec8a0c87abcf30eef2
+static void BM_paint_session_arrange_vanilla(benchmark::State& state, paint_corpus_source_ptr source)
+{
+    paint_corpus_ptr corpus = acquire_corpus(state, *source);
+    if (corpus == nullptr)
+    {
+        return;
+    }
+    // The corpus is shared between benchmarks, only the working copy is ours to arrange.
+    // Once sorted, just restore the journaled fields in place, the lists keep pointing into `sessions`.
+    paint_session_set sessions = paint_corpus_checkout(*corpus);
+    paint_session_journal journal;
+    journal.record(&sessions[0], std::size(sessions));
+    paint_perf_counters counters;
+    // Manually timed around each call only, as the game's globals have to be set up for every session
+    for (auto _ : state)
+    {
+        journal.restore(&sessions[0]);
+        uint64_t ticks = 0;
+        for (int i = 0; i < std::size(sessions); i++) {
+            vanilla_prepare(&sessions[i]);
+            counters.start();
+            uint64_t begin = paint_ticks_begin();
+            vanilla_arrange(&sessions[i]);
+            ticks += paint_ticks_end() - begin;
+            counters.stop();
+        }
+        set_iteration_ticks(state, ticks, std::size(sessions));
+        benchmark::DoNotOptimize(sessions);
+    }
+    state.SetItemsProcessed(state.iterations() * std::size(sessions));
+    report_perf_counters(state, counters, std::size(sessions));
+}
+
+static void fixup()
+{
+#ifdef __linux
+    const char * segments = (char *)(0x401000);
+    int err = mprotect((void *)0x401000, 0x8a4000 - 0x401000, PROT_READ | PROT_EXEC);
+	if (err != 0)
+	{
+		perror("mprotect");
+	}
+	// section: rw data
+	err = mprotect((void *)0x8a4000, 0x01429000 - 0x8a4000, PROT_READ | PROT_WRITE);
+	if (err != 0)
+	{
+		perror("mprotect");
+	}
+#endif
+}
+#else
+static void fixup() {}
+#endif
+
+// Reads a capture just written back and compares it with what was written, session by session
+static bool check_round_trip(const paint_corpus& corpus, const char* fname)
+{
+    paint_corpus_load_options options;
+    options.verbose = false;
+    paint_corpus_ptr written = paint_corpus_load(fname, options);
+    if (written == nullptr)
+    {
+        std::cout << "Round trip failed: " << fname << " does not load" << std::endl;
+        return false;
+    }
+    size_t differing = paint_corpus_differing_sessions(corpus, *written);
+    if (differing != 0)
+    {
+        std::cout << "Round trip failed: " << differing << " of " << corpus.sessions.size() << " sessions in " << fname
+                  << " differ from what was written" << std::endl;
+        return false;
+    }
+    std::cout << "Round trip of " << fname << " reads back all " << corpus.sessions.size() << " sessions" << std::endl;
+    return true;
+}
+
+// psa convert [--format=v2|v3] [--frame-sessions=N] [--encoding=columnar|records|delta] [--rotation=N] <capture> <output>
+// Rewrites a capture as deflated v3 frames (the default) or as uncompressed, directly mappable v2 session images,
+// then reads the result back to check it holds the same sessions.
+// --rotation turns every session to that camera rotation first, see paint_session_rotate().
+static int convert(int argc, char* argv[])
+{
+    std::string format = "v3";
+    int rotation = -1;
+    paint_capture_options options;
+    std::vector<const char*> files;
+    for (int i = 0; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("--format=", 0) == 0)
+        {
+            format = arg.substr(9);
+        }
+        else if (arg.rfind("--frame-sessions=", 0) == 0)
+        {
+            options.frame_sessions = (uint32_t)strtoul(arg.c_str() + 17, nullptr, 10);
+        }
+        else if (arg == "--encoding=records")
+        {
+            options.encoding = paint_frame_encoding::records;
+        }
+        else if (arg == "--encoding=columnar")
+        {
+            options.encoding = paint_frame_encoding::columnar;
+        }
+        else if (arg == "--encoding=delta")
+        {
+            options.encoding = paint_frame_encoding::delta;
+        }
+        else if (arg.rfind("--rotation=", 0) == 0)
+        {
+            rotation = (int)strtoul(arg.c_str() + 11, nullptr, 10);
+        }
+        else
+        {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.size() != 2 || (format != "v2" && format != "v3") || options.frame_sessions == 0 || rotation > 3)
+    {
+        std::cout << "Usage: psa convert [--format=v2|v3] [--frame-sessions=N] [--encoding=columnar|records|delta] "
+                     "[--rotation=N] <capture> <output>"
+                  << std::endl;
+        return 1;
+    }
+    paint_corpus_ptr corpus = paint_corpus_load(files[0]);
+    if (corpus == nullptr)
+    {
+        return 1;
+    }
+    if (rotation >= 0)
+    {
+        corpus = paint_corpus_rotate(*corpus, (uint8_t)rotation);
+    }
+    bool written = format == "v2" ? paint_corpus_write_v2(*corpus, files[1]) : paint_corpus_write_v3(*corpus, files[1], options);
+    return written && check_round_trip(*corpus, files[1]) ? 0 : 1;
+}
+
+// psa generate [--structs=N] [--quadrants=N] [--overlap=N] [--rotation=N] [--heights=flat|uniform|stacked]
+//              [--max-height=N] [--seed=N] [--sessions=N] [--format=v2|v3] <output>
+// Writes a synthetic capture, see paint_scene_options for what the knobs do.
+static int generate(int argc, char* argv[])
+{
+    paint_scene_options options;
+    size_t count = 1;
+    std::string format = "v3";
+    std::string heights = "uniform";
+    std::vector<const char*> files;
+    for (int i = 0; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        auto value = [&arg]() { return strtoul(arg.c_str() + arg.find('=') + 1, nullptr, 10); };
+        if (arg.rfind("--structs=", 0) == 0)
+        {
+            options.structs = (uint32_t)value();
+        }
+        else if (arg.rfind("--quadrants=", 0) == 0)
+        {
+            options.quadrants = (uint32_t)value();
+        }
+        else if (arg.rfind("--overlap=", 0) == 0)
+        {
+            options.overlap = (uint32_t)value();
+        }
+        else if (arg.rfind("--rotation=", 0) == 0)
+        {
+            options.rotation = (uint8_t)value();
+        }
+        else if (arg.rfind("--heights=", 0) == 0)
+        {
+            heights = arg.substr(10);
+        }
+        else if (arg.rfind("--max-height=", 0) == 0)
+        {
+            options.max_height = (uint16_t)value();
+        }
+        else if (arg.rfind("--seed=", 0) == 0)
+        {
+            options.seed = (uint32_t)value();
+        }
+        else if (arg.rfind("--sessions=", 0) == 0)
+        {
+            count = value();
+        }
+        else if (arg.rfind("--format=", 0) == 0)
+        {
+            format = arg.substr(9);
+        }
+        else
+        {
+            files.push_back(argv[i]);
+        }
+    }
+    if (heights == "flat")
+    {
+        options.heights = paint_scene_heights::flat;
+    }
+    else if (heights == "stacked")
+    {
+        options.heights = paint_scene_heights::stacked;
+    }
+    paint_corpus_ptr corpus = paint_scene_generate(options, count);
+    if (files.size() != 1 || corpus == nullptr || count == 0 || (format != "v2" && format != "v3")
+        || (heights != "flat" && heights != "uniform" && heights != "stacked"))
+    {
+        std::cout << "Usage: psa generate [--structs=N] [--quadrants=N] [--overlap=N] [--rotation=N] "
+                     "[--heights=flat|uniform|stacked] [--max-height=N] [--seed=N] [--sessions=N] [--format=v2|v3] <output>"
+                  << std::endl;
+        return 1;
+    }
+    bool written = format == "v2" ? paint_corpus_write_v2(*corpus, files[0]) : paint_corpus_write_v3(*corpus, files[0]);
+    return written && check_round_trip(*corpus, files[0]) ? 0 : 1;
+}
+
+// psa render [--engine=opt|openrct2|both] [--zoom=N] <capture> <session> <output.png|output.ppm>
+// Arranges one session and draws it with the box rasteriser. "both" draws the opt result and counts the pixels
+// where the two engines' pictures differ.
+static int render(int argc, char* argv[])
+{
+    std::string engine = "opt";
+    unsigned long zoom = 0;
+    std::vector<const char*> files;
+    for (int i = 0; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("--engine=", 0) == 0)
+        {
+            engine = arg.substr(9);
+        }
+        else if (arg.rfind("--zoom=", 0) == 0)
+        {
+            zoom = strtoul(arg.c_str() + 7, nullptr, 10);
+        }
+        else
+        {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.size() != 3 || (engine != "opt" && engine != "openrct2" && engine != "both") || zoom > 7)
+    {
+        std::cout << "Usage: psa render [--engine=opt|openrct2|both] [--zoom=N] <capture> <session> <output.png|output.ppm>"
+                  << std::endl;
+        return 1;
+    }
+    size_t index = strtoul(files[1], nullptr, 10);
+    // Arranging works in place, so each engine gets a freshly loaded session
+    auto draw = [&](void (*arrange)(paint_session*), std::vector<uint8_t>& bits, rct_drawpixelinfo& dpi) {
+        std::unique_ptr<paint_session> session = paint_corpus_load_session(files[0], index);
+        if (session == nullptr)
+        {
+            return false;
+        }
+        arrange(session.get());
+        if (!make_session_bitmap(*session, (uint16_t)zoom, dpi))
+        {
+            std::cout << "Session " << index << " has nothing to draw at zoom " << zoom
+                      << ", or reaches past the 16-bit screen coordinates" << std::endl;
+            return false;
+        }
+        bits.assign((size_t)dpi.width * dpi.height, 0);
+        dpi.bits = bits.data();
+        paint_session_rasterise(*session, dpi);
+        return true;
+    };
+    std::vector<uint8_t> bits;
+    rct_drawpixelinfo dpi;
+    if (!draw(engine == "openrct2" ? paint_session_arrange : paint_session_arrange_opt, bits, dpi))
+    {
+        return 1;
+    }
+    if (engine == "both")
+    {
+        std::vector<uint8_t> reference;
+        rct_drawpixelinfo reference_dpi;
+        if (!draw(paint_session_arrange, reference, reference_dpi))
+        {
+            return 1;
+        }
+        size_t differing = 0;
+        for (size_t i = 0; i < bits.size(); i++)
+        {
+            differing += bits[i] != reference[i];
+        }
+        std::cout << differing << " of " << bits.size() << " pixels differ between opt and openrct2" << std::endl;
+    }
+    if (!paint_raster_write(dpi, files[2]))
+    {
+        return 1;
+    }
+    std::cout << "Wrote " << dpi.width << "x" << dpi.height << " session " << index << " to " << files[2] << std::endl;
+    return 0;
+}
+
+// Arranges every session of the corpus turned to each camera rotation with every engine, and reports how many
+// arranged differently from openrct2's
+static bool verify_rotations(const paint_corpus& corpus)
+{
+    bool ok = true;
+    for (uint8_t rotation = 0; rotation < 4; rotation++)
+    {
+        paint_corpus_ptr rotated = paint_corpus_rotate(corpus, rotation);
+        paint_session_set sessions = paint_corpus_checkout(*rotated);
+        paint_session_journal journal;
+        journal.record(&sessions[0], std::size(sessions));
+        std::vector<std::string> expected;
+        for (auto& session : sessions)
+        {
+            paint_session_arrange(&session);
+            expected.push_back(paint_struct_list_to_string(session.PaintHead.next_quadrant_ps, &session.PaintStructs[0].basic));
+        }
+        journal.restore(&sessions[0]);
+        size_t opt_differing = 0;
+        for (size_t i = 0; i < std::size(sessions); i++)
+        {
+            paint_session_arrange_opt(&sessions[i]);
+            const paint_struct* head = sessions[i].PaintHead.next_quadrant_ps;
+            opt_differing += paint_struct_list_to_string(head, &sessions[i].PaintStructs[0].basic) != expected[i];
+        }
+        std::cout << "rotation " << (int)rotation << ": " << opt_differing << " of " << std::size(sessions)
+                  << " sessions differ between opt and openrct2";
+        ok = ok && opt_differing == 0;
+#if defined(__i386__) || defined(_M_IX86)
+        journal.restore(&sessions[0]);
+        size_t vanilla_differing = 0;
+        for (size_t i = 0; i < std::size(sessions); i++)
+        {
+            vanilla_prepare(&sessions[i]);
+            vanilla_arrange(&sessions[i]);
+            const paint_struct* head = RCT2_GLOBAL(0x00EE7888, paint_struct*)->next_quadrant_ps;
+            vanilla_differing += paint_struct_list_to_string(head, &sessions[i].PaintStructs[0].basic) != expected[i];
+        }
+        std::cout << ", " << vanilla_differing << " between vanilla and openrct2";
+        ok = ok && vanilla_differing == 0;
+#endif
+        std::cout << std::endl;
+    }
+    return ok;
+}
+
+static void register_capture_benchmarks(std::string name, const paint_capture_info& info,
+    [[maybe_unused]] std::shared_ptr<std::ostream> op_counts_csv, bool rotations)
+{
+    auto corpus = std::make_shared<paint_corpus_source>(name, info, [=](const paint_corpus& loaded) {
+        if (!verify(loaded))
+        {
+            //return 1;
+        }
+        if (rotations)
+        {
+            verify_rotations(loaded);
+        }
+        report_batches(loaded);
+#ifdef PSA_OPCOUNTERS
+        if (op_counts_csv != nullptr)
+        {
+            write_op_counts(*op_counts_csv, loaded);
+        }
+#endif
+    });
+    benchmark::RegisterBenchmark(name.c_str(), BM_paint_session_arrange, corpus)->UseManualTime();
+    std::string name_opt = name + "_opt";
+    benchmark::RegisterBenchmark(name_opt.c_str(), BM_paint_session_arrange_opt, corpus)->UseManualTime();
+    std::string name_cached = name + "_opt_cached";
+    benchmark::RegisterBenchmark(name_cached.c_str(), BM_paint_session_arrange_cached, corpus)->UseManualTime();
+    std::string name_evicted = name + "_opt_evicted";
+    benchmark::RegisterBenchmark(name_evicted.c_str(), BM_paint_session_arrange_cold, corpus, cache_disturbance::evict)
+        ->UseManualTime();
+    std::string name_flushed = name + "_opt_flushed";
+    benchmark::RegisterBenchmark(name_flushed.c_str(), BM_paint_session_arrange_cold, corpus, cache_disturbance::flush)
+        ->UseManualTime();
+    std::string name_latency = name + "_latency";
+    benchmark::RegisterBenchmark(name_latency.c_str(), BM_paint_session_arrange_latency, corpus)->UseManualTime();
+    std::string name_frame = name + "_frame";
+    benchmark::RegisterBenchmark(name_frame.c_str(), BM_paint_session_frame, corpus)->UseManualTime();
+    std::string name_raster = name + "_raster";
+    benchmark::RegisterBenchmark(name_raster.c_str(), BM_paint_session_raster, corpus)
+        ->ArgName("zoom")
+        ->Arg(0)
+        ->Arg(2)
+        ->UseManualTime();
+    std::string name_batch = name + "_batch";
+    benchmark::RegisterBenchmark(name_batch.c_str(), BM_paint_session_batch, corpus);
+    std::string name_submit = name + "_submit";
+    benchmark::RegisterBenchmark(name_submit.c_str(), BM_paint_session_submit, corpus)
+        ->DenseRange(1, std::max(1u, std::thread::hardware_concurrency()))
+        ->UseRealTime();
+    std::string name_decode = name + "_decode";
+    benchmark::RegisterBenchmark(name_decode.c_str(), BM_paint_session_decode, corpus)->Unit(benchmark::kMillisecond);
+    std::string name_load = name + "_load";
+    benchmark::RegisterBenchmark(name_load.c_str(), BM_paint_corpus_load, name)
+        ->DenseRange(1, std::max(1u, std::thread::hardware_concurrency()))
+        ->UseRealTime()
+        ->Unit(benchmark::kMillisecond);
+    std::string name_load_last = name + "_load_last";
+    benchmark::RegisterBenchmark(name_load_last.c_str(), BM_paint_corpus_load_session, name, info.session_count - 1)
+        ->Unit(benchmark::kMillisecond);
+    // Sweeps fit how each engine grows with the structs it arranges. They stop about where the largest captured
+    // sessions do, beyond that nothing is left to cut.
+    const struct
+    {
+        const char* suffix;
+        paint_sweep sweep;
+        int64_t first;
+        int64_t last;
+    } sweeps[] = { { "_quadrants", paint_sweep::quadrants, 1, 256 }, { "_structs", paint_sweep::structs, 16, 2048 } };
+    const struct
+    {
+        const char* suffix;
+        void (*prepare)(paint_session*);
+        void (*arrange)(paint_session*);
+    } engines[] = {
+        { "_openrct2", nullptr, paint_session_arrange },
+        { "_opt", nullptr, paint_session_arrange_opt },
+#if defined(__i386__) || defined(_M_IX86)
+        { "_vanilla", vanilla_prepare, vanilla_arrange },
+#endif
+    };
+    for (const auto& sweep : sweeps)
+    {
+        for (const auto& engine : engines)
+        {
+            std::string name_sweep = name + sweep.suffix + engine.suffix;
+            benchmark::RegisterBenchmark(
+                name_sweep.c_str(), BM_paint_session_sweep, corpus, sweep.sweep, engine.prepare, engine.arrange)
+                ->RangeMultiplier(2)
+                ->Range(sweep.first, sweep.last)
+                ->Complexity()
+                ->UseManualTime();
+        }
+    }
+    if (rotations)
+    {
+        for (const auto& engine : engines)
+        {
+            std::string name_rotation = name + "_rotation" + engine.suffix;
+            benchmark::RegisterBenchmark(
+                name_rotation.c_str(), BM_paint_session_rotation, corpus, engine.prepare, engine.arrange)
+                ->ArgName("rotation")
+                ->DenseRange(0, 3)
+                ->UseManualTime();
+        }
+    }
+#if defined(__i386__) || defined(_M_IX86)
+    name += " vanilla";
+    benchmark::RegisterBenchmark(name.c_str(), BM_paint_session_arrange_vanilla, corpus)->UseManualTime();
+#endif
+}
+
+int main_psa(int argc, char* argv[])
+{
+    auto startup_begin = std::chrono::steady_clock::now();
+    fixup();
+    if (argc >= 2 && std::string(argv[1]) == "convert")
+    {
+        return convert(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && std::string(argv[1]) == "render")
+    {
+        return render(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && std::string(argv[1]) == "generate")
+    {
+        return generate(argc - 2, argv + 2);
+    }
+    {
+        // Register some basic "baseline" benchmark: a single session with every list empty
+        std::vector<paint_session> sessions(1);
+        benchmark::RegisterBenchmark("baseline", BM_paint_session_arrange,
+            std::make_shared<paint_corpus_source>(paint_corpus_create("baseline", "", std::move(sessions))))
+            ->UseManualTime();
+    }
+
+    {
+        // Generated scenes: a spread of sizes and densities, then every rotation, then the helper's worst case of
+        // small, low boxes in a single quadrant (see paint_scene_options)
+        benchmark::RegisterBenchmark("synthetic", BM_paint_scene_arrange, paint_scene_options{}, paint_session_arrange_opt)
+            ->ArgNames({ "structs", "quadrants", "overlap", "rotation" })
+            ->ArgsProduct({ { 250, 1000, 4000 }, { 1, 32 }, { 25, 100 }, { 0 } })
+            ->Args({ 1000, 32, 50, 1 })
+            ->Args({ 1000, 32, 50, 2 })
+            ->Args({ 1000, 32, 50, 3 })
+            ->UseManualTime();
+        paint_scene_options worst;
+        worst.max_height = 16;
+        for (auto [name, arrange] : { std::pair{ "synthetic_worst", paint_session_arrange_opt },
+                                      std::pair{ "synthetic_worst_openrct2", paint_session_arrange } })
+        {
+            benchmark::RegisterBenchmark(name, BM_paint_scene_arrange, worst, arrange)
+                ->ArgNames({ "structs", "quadrants", "overlap", "rotation" })
+                ->ArgsProduct({ { 250, 1000, 2000, 4000 }, { 1 }, { 25 }, { 0 } })
+                ->UseManualTime();
+        }
+    }
+
+    std::vector<char*> argv_for_benchmark;
+
+    argv_for_benchmark.push_back(argv[0]);
+
+    // Extract file names from argument list. If there is no such file, consider it benchmark option.
+    std::vector<std::string> captures;
+    std::shared_ptr<std::ostream> op_counts_csv;
+    // --rotations: also arrange and verify every capture turned to each camera rotation, wherever the flag appears
+    bool rotations = std::any_of(argv + 1, argv + argc, [](const char* arg) { return std::string(arg) == "--rotations"; });
+    for (int i = 1; i < argc; i++)
+    {
+        // --opcounters_csv=<file>: arrange work per engine, session and quadrant of every capture benchmarked
+        std::string arg = argv[i];
+        if (arg.rfind("--opcounters_csv=", 0) == 0)
+        {
+#ifdef PSA_OPCOUNTERS
+            op_counts_csv = std::make_shared<std::ofstream>(arg.substr(17));
+            *op_counts_csv << "capture,engine,session,quadrant,walk_steps,bbox_checks,bbox_true,flag_passes\n";
+#else
+            std::cout << "Built without WITH_OPCOUNTERS, ignoring " << arg << std::endl;
+#endif
+            continue;
+        }
+        if (arg == "--rotations")
+        {
+            continue;
+        }
+        std::vector<std::string> files = expand_capture_argument(argv[i]);
+        if (files.empty())
+        {
+            argv_for_benchmark.push_back((char*)argv[i]);
+        }
+        for (const auto& name : files)
+        {
+            // Register benchmark for sv6 if valid. Only the header is read here, the capture is loaded, verified
+            // and kept by the first benchmark that runs on it.
+            paint_capture_info info;
+            if (paint_corpus_probe(name.c_str(), info))
+            {
+                register_capture_benchmarks(name, info, op_counts_csv, rotations);
+                captures.push_back(name);
+            }
+        }
+    }
+    if (captures.size() > 1)
+    {
+        std::string name_all = "corpus_" + std::to_string(captures.size()) + "_captures";
+        std::string name_load_all = name_all + "_load";
+        benchmark::RegisterBenchmark(name_load_all.c_str(), BM_paint_corpus_load_all, captures)
+            ->DenseRange(1, std::max(1u, std::thread::hardware_concurrency()))
+            ->UseRealTime()
+            ->Unit(benchmark::kMillisecond);
+        std::string name_opt_all = name_all + "_opt";
+        benchmark::RegisterBenchmark(name_opt_all.c_str(), BM_paint_corpus_arrange_all, captures)->UseManualTime()->Unit(benchmark::kMillisecond);
+    }
+
+    // Tag results with the paint_struct layout, so runs of compressed and native builds can be compared
+#ifdef PSA_COMPRESSED_POINTERS
+    std::string layout = "compressed links, ";
+#else
+    std::string layout = "native pointers, ";
+#endif
+    layout += std::to_string(sizeof(paint_struct)) + " bytes, " + std::to_string(64.0 / sizeof(paint_struct))
+        + " per cache line";
+    benchmark::AddCustomContext("paint_struct", layout);
+
+    auto startup = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startup_begin);
+    std::cout << "Startup took " << startup.count() << " ms, peak RSS " << (platform_peak_rss() >> 20) << " MiB" << std::endl;
 
     // Update argc with all the changes made
     argc = (int)argv_for_benchmark.size();
@@ -410,6 +1712,7 @@ int main_psa(int argc, char* argv[])
     if (::benchmark::ReportUnrecognizedArguments(argc, &argv_for_benchmark[0]))
         return -1;
     ::benchmark::RunSpecifiedBenchmarks();
+    std::cout << "Peak RSS " << (platform_peak_rss() >> 20) << " MiB" << std::endl;
     return 0;
 }
 #else
@@ -447,11 +1750,11 @@ int main(int argc, const char* argv[])
     {
         if (platform_file_exists(argv[i]))
         {
-            // Register benchmark for sv6 if valid
-            std::vector<paint_session> sessions = extract_paint_session(argv[i]);
-            if (!sessions.empty())
+            paint_corpus_ptr corpus = paint_corpus_load(argv[i]);
+            if (corpus != nullptr)
             {
-                verify(sessions);
+                verify(*corpus);
+                report_batches(*corpus);
             }
         }
     }
@@ -465,11 +1768,11 @@ extern "C" __declspec(dllexport) int StartOpenRCT(HINSTANCE hInstance, HINSTANCE
     {
         if (platform_file_exists(argv[i]))
         {
-            // Register benchmark for sv6 if valid
-            std::vector<paint_session> sessions = extract_paint_session(argv[i]);
-            if (!sessions.empty())
+            paint_corpus_ptr corpus = paint_corpus_load(argv[i]);
+            if (corpus != nullptr)
             {
-                verify(sessions);
+                verify(*corpus);
+                report_batches(*corpus);
             }
         }
     }
@@ -0,0 +1,112 @@
+#include "psa_arrange_cache.h"
+#include "psa_openrct2.h"
+
+#include <algorithm>
+
+constexpr uint32_t quadrant_count = sizeof(paint_session::Quadrants) / sizeof(paint_session::Quadrants[0]);
+
+static void arrange_key(const paint_session& session, std::vector<uint16_t>& key)
+{
+    key.clear();
+    key.push_back((uint16_t)session.QuadrantBackIndex);
+    key.push_back((uint16_t)(session.QuadrantBackIndex >> 16));
+    key.push_back((uint16_t)session.QuadrantFrontIndex);
+    key.push_back((uint16_t)(session.QuadrantFrontIndex >> 16));
+    key.push_back(session.CurrentRotation);
+    if (session.QuadrantBackIndex == UINT32_MAX)
+    {
+        return;
+    }
+    uint32_t front = std::min(session.QuadrantFrontIndex, quadrant_count - 1);
+    for (uint32_t quadrant = session.QuadrantBackIndex; quadrant <= front; quadrant++)
+    {
+        for (const paint_struct* ps = session.Quadrants[quadrant]; ps != nullptr; ps = ps->next_quadrant_ps)
+        {
+            const auto& bounds = ps->bounds;
+            key.insert(key.end(),
+                { (uint16_t)((const paint_entry*)ps - session.PaintStructs), ps->quadrant_index, ps->quadrant_flags,
+                  bounds.x, bounds.y, bounds.z, bounds.x_end, bounds.y_end, bounds.z_end });
+        }
+        // Ends the list, so structs moving between neighbouring quadrants change the key
+        key.push_back(UINT16_MAX);
+    }
+}
+
+static uint64_t hash_key(const std::vector<uint16_t>& key)
+{
+    uint64_t hash = 0xCBF29CE484222325;
+    for (uint16_t word : key)
+    {
+        hash = (hash ^ word) * 0x100000001B3;
+    }
+    return hash;
+}
+
+paint_arrange_cache::paint_arrange_cache(size_t capacity)
+    : _capacity(std::max<size_t>(capacity, 1))
+{
+}
+
+bool paint_arrange_cache::arrange(paint_session* session)
+{
+    arrange_key(*session, _key);
+    uint64_t hash = hash_key(_key);
+    auto range = _by_hash.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        const entry& cached = *it->second;
+        if (cached.key != _key)
+        {
+            continue;
+        }
+        paint_struct* previous = &session->PaintHead;
+        for (size_t i = 0; i < cached.order.size(); i++)
+        {
+            paint_struct* ps = &session->PaintStructs[cached.order[i]].basic;
+            ps->quadrant_flags = cached.flags[i];
+            previous->next_quadrant_ps = ps;
+            previous = ps;
+        }
+        previous->next_quadrant_ps = nullptr;
+        session->PaintHead.quadrant_flags = cached.head_flags;
+        _entries.splice(_entries.begin(), _entries, it->second);
+        _hits++;
+        return true;
+    }
+
+    paint_session_arrange_opt(session);
+    _misses++;
+    if (_entries.size() == _capacity)
+    {
+        auto evicted = std::prev(_entries.end());
+        auto evicted_range = _by_hash.equal_range(evicted->hash);
+        for (auto it = evicted_range.first; it != evicted_range.second; ++it)
+        {
+            if (it->second == evicted)
+            {
+                _by_hash.erase(it);
+                break;
+            }
+        }
+        _entries.erase(evicted);
+    }
+    entry& added = _entries.emplace_front();
+    added.hash = hash;
+    added.key = _key;
+    for (const paint_struct* ps = session->PaintHead.next_quadrant_ps; ps != nullptr; ps = ps->next_quadrant_ps)
+    {
+        added.order.push_back((uint16_t)((const paint_entry*)ps - session->PaintStructs));
+        added.flags.push_back(ps->quadrant_flags);
+    }
+    added.head_flags = session->PaintHead.quadrant_flags;
+    _by_hash.emplace(hash, _entries.begin());
+    return false;
+}
+
+void paint_arrange_cache::clear()
+{
+    _entries.clear();
+    _by_hash.clear();
+    _hits = 0;
+    _misses = 0;
+}
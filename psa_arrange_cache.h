@@ -0,0 +1,52 @@
+#pragma once
+#include "structs.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Remembers what paint_session_arrange_opt() made of the last `capacity` distinct sessions, evicting the least
+ * recently used. A session's key is everything arrange reads: its quadrant range and rotation, and the index,
+ * quadrant, flags and bounds of every struct on the quadrant lists in that range, in list order.
+ * A hit writes back the remembered draw order and quadrant flags instead of sorting, which leaves the session
+ * exactly as arranging it would have.
+ */
+class paint_arrange_cache
+{
+public:
+    explicit paint_arrange_cache(size_t capacity);
+
+    // Returns true if the session was arranged from the cache
+    bool arrange(paint_session* session);
+    void clear();
+
+    size_t hits() const
+    {
+        return _hits;
+    }
+    size_t misses() const
+    {
+        return _misses;
+    }
+
+private:
+    struct entry
+    {
+        uint64_t hash;
+        std::vector<uint16_t> key;
+        // Arranged list as struct indices, with each struct's flags after arranging
+        std::vector<uint16_t> order;
+        std::vector<uint8_t> flags;
+        uint8_t head_flags;
+    };
+
+    size_t _capacity;
+    std::list<entry> _entries; // most recently used first
+    std::unordered_multimap<uint64_t, std::list<entry>::iterator> _by_hash;
+    std::vector<uint16_t> _key;
+    size_t _hits = 0;
+    size_t _misses = 0;
+};
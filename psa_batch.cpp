@@ -0,0 +1,25 @@
+#include "psa_batch.h"
+
+void paint_session_batch(const paint_session& session, paint_batch_list& list)
+{
+    list.structs.clear();
+    list.batches.clear();
+    bool batch_open = false;
+    for (const paint_struct* ps = session.PaintHead.next_quadrant_ps; ps != nullptr; ps = ps->next_quadrant_ps)
+    {
+        uint32_t index = (uint32_t)list.structs.size();
+        list.structs.push_back(ps);
+        if (batch_open)
+        {
+            paint_batch& batch = list.batches.back();
+            if (batch.image_id == ps->image_id && batch.colour_image_id == ps->colour_image_id)
+            {
+                batch.count++;
+                batch_open = ps->attached_ps == nullptr && ps->children == nullptr;
+                continue;
+            }
+        }
+        list.batches.push_back({ ps->image_id, ps->colour_image_id, index, 1 });
+        batch_open = ps->attached_ps == nullptr && ps->children == nullptr;
+    }
+}
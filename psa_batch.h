@@ -0,0 +1,30 @@
+#pragma once
+#include "structs.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * A run of consecutive structs in draw order that share one sprite, so a renderer can look the sprite up once
+ * and blit it at every member's x/y. Only the last member may have attached_ps or children: those are drawn
+ * straight after their parent, so a struct with either ends the run.
+ */
+struct paint_batch
+{
+    uint32_t image_id;
+    uint32_t colour_image_id;
+    uint32_t first; // index into paint_batch_list::structs
+    uint32_t count;
+};
+
+struct paint_batch_list
+{
+    std::vector<const paint_struct*> structs; // arranged draw order
+    std::vector<paint_batch> batches;
+};
+
+/**
+ * Walks PaintHead.next_quadrant_ps of an arranged session and groups it into sprite batches.
+ * `list` is cleared first; reusing it across calls avoids reallocations.
+ */
+void paint_session_batch(const paint_session& session, paint_batch_list& list);
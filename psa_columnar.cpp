@@ -0,0 +1,224 @@
+#include "psa_columnar.h"
+
+#include <type_traits>
+
+constexpr uint32_t structs_per_session = sizeof(paint_session::PaintStructs) / sizeof(paint_entry);
+constexpr uint32_t quadrants_per_session = sizeof(paint_session::Quadrants) / sizeof(paint_session::Quadrants[0]);
+// Each session contributes its structs and then its head to every struct column
+constexpr uint32_t struct_column_period = structs_per_session + 1;
+constexpr uint32_t null_link = structs_per_session;
+
+enum class predictor
+{
+    // Stored as is: z, flags and image ids jump around too much to predict
+    none,
+    // Difference to the previous value of the column: positions drift slowly through draw order
+    previous,
+    // Difference to the value's own index within its session: lists mostly link to nearby structs
+    position,
+};
+
+template<typename T> static T zigzag(T delta)
+{
+    using S = std::make_signed_t<T>;
+    return (T)((T)(delta << 1) ^ (T)((S)delta >> (sizeof(T) * 8 - 1)));
+}
+
+template<typename T> static T unzigzag(T residue)
+{
+    return (T)((residue >> 1) ^ (T)(0 - (residue & 1)));
+}
+
+template<typename T> static void put_column(std::vector<uint8_t>& out, const std::vector<T>& values, predictor p, uint32_t period)
+{
+    size_t n = values.size();
+    size_t begin = out.size();
+    out.resize(begin + n * sizeof(T));
+    uint8_t* planes = out.data() + begin;
+    T previous = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        T residue = values[i];
+        if (p == predictor::previous)
+        {
+            residue = zigzag<T>((T)(values[i] - previous));
+        }
+        else if (p == predictor::position)
+        {
+            residue = zigzag<T>((T)(values[i] - (T)(i % period)));
+        }
+        previous = values[i];
+        for (size_t b = 0; b < sizeof(T); b++)
+        {
+            planes[b * n + i] = (uint8_t)(residue >> (8 * b));
+        }
+    }
+}
+
+// Plane merging and residue decoding are independent per element and vectorise, only `previous` carries a sum
+template<typename T> static void get_column(const uint8_t*& src, size_t n, predictor p, uint32_t period, std::vector<T>& values)
+{
+    values.resize(n);
+    T* out = values.data();
+    for (size_t i = 0; i < n; i++)
+    {
+        T value = 0;
+        for (size_t b = 0; b < sizeof(T); b++)
+        {
+            value |= (T)(src[b * n + i] << (8 * b));
+        }
+        out[i] = value;
+    }
+    src += n * sizeof(T);
+    if (p == predictor::previous)
+    {
+        T sum = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            sum = (T)(sum + unzigzag(out[i]));
+            out[i] = sum;
+        }
+    }
+    else if (p == predictor::position)
+    {
+        for (size_t i = 0; i < n; i += period)
+        {
+            for (uint32_t j = 0; j < period && i + j < n; j++)
+            {
+                out[i + j] = (T)(unzigzag(out[i + j]) + (T)j);
+            }
+        }
+    }
+}
+
+template<typename T, typename F>
+static std::vector<T> gather_structs(const paint_session* const* sessions, size_t count, F field)
+{
+    std::vector<T> values;
+    values.reserve(count * struct_column_period);
+    for (size_t s = 0; s < count; s++)
+    {
+        for (const auto& entry : sessions[s]->PaintStructs)
+        {
+            values.push_back((T)field(*sessions[s], entry.basic));
+        }
+        values.push_back((T)field(*sessions[s], sessions[s]->PaintHead));
+    }
+    return values;
+}
+
+static uint32_t link_index(const paint_session& session, const paint_struct* target)
+{
+    return target == nullptr ? null_link : (uint32_t)((const paint_entry*)target - session.PaintStructs);
+}
+
+size_t paint_columns_size(size_t session_count)
+{
+    // Nine 16-bit struct columns, quadrant flags, image ids and links, then quadrants and both quadrant indices
+    return session_count * (struct_column_period * (9 * 2 + 1 + 4 + 4) + quadrants_per_session * 4 + 2 * 4);
+}
+
+void paint_columns_encode(const paint_session* const* sessions, size_t session_count, std::vector<uint8_t>& out)
+{
+    using ps_t = const paint_struct&;
+    using session_t = const paint_session&;
+    auto structs = [&](auto field) { return gather_structs<uint16_t>(sessions, session_count, field); };
+    put_column(out, structs([](session_t, ps_t ps) { return ps.bounds.x; }), predictor::previous, 0);
+    put_column(out, structs([](session_t, ps_t ps) { return ps.bounds.y; }), predictor::previous, 0);
+    put_column(out, structs([](session_t, ps_t ps) { return ps.bounds.z; }), predictor::none, 0);
+    // Box extents are far more regular than the far corner itself
+    put_column(out, structs([](session_t, ps_t ps) { return ps.bounds.x_end - ps.bounds.x; }), predictor::none, 0);
+    put_column(out, structs([](session_t, ps_t ps) { return ps.bounds.y_end - ps.bounds.y; }), predictor::none, 0);
+    put_column(out, structs([](session_t, ps_t ps) { return ps.bounds.z_end - ps.bounds.z; }), predictor::previous, 0);
+    put_column(out, structs([](session_t, ps_t ps) { return ps.x; }), predictor::previous, 0);
+    put_column(out, structs([](session_t, ps_t ps) { return ps.y; }), predictor::previous, 0);
+    put_column(out, structs([](session_t, ps_t ps) { return ps.quadrant_index; }), predictor::previous, 0);
+    put_column(out, gather_structs<uint8_t>(sessions, session_count, [](session_t, ps_t ps) { return ps.quadrant_flags; }),
+        predictor::none, 0);
+    put_column(out, gather_structs<uint32_t>(sessions, session_count, [](session_t, ps_t ps) { return ps.image_id; }),
+        predictor::none, 0);
+    put_column(out,
+        gather_structs<uint32_t>(
+            sessions, session_count, [](session_t session, ps_t ps) { return link_index(session, ps.next_quadrant_ps); }),
+        predictor::position, struct_column_period);
+
+    std::vector<uint32_t> quadrants;
+    std::vector<uint32_t> back;
+    std::vector<uint32_t> front;
+    for (size_t s = 0; s < session_count; s++)
+    {
+        for (const auto& quadrant : sessions[s]->Quadrants)
+        {
+            quadrants.push_back(link_index(*sessions[s], quadrant));
+        }
+        back.push_back(sessions[s]->QuadrantBackIndex);
+        front.push_back(sessions[s]->QuadrantFrontIndex);
+    }
+    put_column(out, quadrants, predictor::previous, 0);
+    put_column(out, back, predictor::none, 0);
+    put_column(out, front, predictor::none, 0);
+}
+
+bool paint_columns_decode(
+    const uint8_t* data, size_t size, size_t session_count, size_t first, paint_session* sessions, size_t count)
+{
+    if (size != paint_columns_size(session_count) || first + count > session_count)
+    {
+        return false;
+    }
+    size_t n = session_count * struct_column_period;
+    const uint8_t* src = data;
+    std::vector<uint16_t> x, y, z, x_extent, y_extent, z_extent, screen_x, screen_y, quadrant_index;
+    std::vector<uint8_t> quadrant_flags;
+    std::vector<uint32_t> image_id, next, quadrants, back, front;
+    get_column(src, n, predictor::previous, 0, x);
+    get_column(src, n, predictor::previous, 0, y);
+    get_column(src, n, predictor::none, 0, z);
+    get_column(src, n, predictor::none, 0, x_extent);
+    get_column(src, n, predictor::none, 0, y_extent);
+    get_column(src, n, predictor::previous, 0, z_extent);
+    get_column(src, n, predictor::previous, 0, screen_x);
+    get_column(src, n, predictor::previous, 0, screen_y);
+    get_column(src, n, predictor::previous, 0, quadrant_index);
+    get_column(src, n, predictor::none, 0, quadrant_flags);
+    get_column(src, n, predictor::none, 0, image_id);
+    get_column(src, n, predictor::position, struct_column_period, next);
+    get_column(src, session_count * quadrants_per_session, predictor::previous, 0, quadrants);
+    get_column(src, session_count, predictor::none, 0, back);
+    get_column(src, session_count, predictor::none, 0, front);
+
+    // Structs are assembled from all columns at once, so every one of them is written exactly once
+    bool valid = true;
+    auto resolve = [&valid](paint_session& session, uint32_t index) -> paint_struct* {
+        valid &= index <= null_link;
+        return index < null_link ? &session.PaintStructs[index].basic : nullptr;
+    };
+    for (size_t s = 0; s < count; s++)
+    {
+        paint_session& session = sessions[s];
+        size_t i = (first + s) * struct_column_period;
+        for (uint32_t j = 0; j < struct_column_period; j++, i++)
+        {
+            paint_struct& ps = j < structs_per_session ? session.PaintStructs[j].basic : session.PaintHead;
+            ps.bounds.x = x[i];
+            ps.bounds.y = y[i];
+            ps.bounds.z = z[i];
+            ps.bounds.x_end = (uint16_t)(x[i] + x_extent[i]);
+            ps.bounds.y_end = (uint16_t)(y[i] + y_extent[i]);
+            ps.bounds.z_end = (uint16_t)(z[i] + z_extent[i]);
+            ps.x = screen_x[i];
+            ps.y = screen_y[i];
+            ps.quadrant_index = quadrant_index[i];
+            ps.quadrant_flags = quadrant_flags[i];
+            ps.image_id = image_id[i];
+            ps.next_quadrant_ps = resolve(session, next[i]);
+        }
+        for (uint32_t q = 0; q < quadrants_per_session; q++)
+        {
+            session.Quadrants[q] = resolve(session, quadrants[(first + s) * quadrants_per_session + q]);
+        }
+        session.QuadrantBackIndex = back[first + s];
+        session.QuadrantFrontIndex = front[first + s];
+    }
+    return valid;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "structs.h"
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Columnar encoding of whole sessions, used for v3 capture frames before they are deflated.
+ * Every paint_struct field becomes a column over all structs of the frame, each session's head following its
+ * 4000 structs. Columns are stored as prediction residues split into byte planes, least significant byte first.
+ * Links are stored as struct indices, 4000 meaning null, and come out of the decoder fully resolved.
+ */
+size_t paint_columns_size(size_t session_count);
+
+// `sessions` points to each session, so sessions that share storage are encoded without copying them
+void paint_columns_encode(const paint_session* const* sessions, size_t session_count, std::vector<uint8_t>& out);
+
+/**
+ * Decodes sessions [first, first + count) of data holding `session_count` sessions into value-initialised `sessions`.
+ * Returns false if the data does not match the count or a link points outside its session.
+ */
+bool paint_columns_decode(
+    const uint8_t* data, size_t size, size_t session_count, size_t first, paint_session* sessions, size_t count);
@@ -0,0 +1,1505 @@
+#include "psa_corpus.h"
+#include "InflateStream.h"
+#include "MappedFile.h"
+#include "MemoryStream.h"
+#include "psa_columnar.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <zlib.h>
+
+// Links are written as raw indices, widened to the full link so a native pointer holds exactly set_link_index()'s value
+using link_word = std::conditional_t<sizeof(paint_struct::next_quadrant_ps) == 4, uint32_t, uint64_t>;
+
+// Paint struct record. Records come in two versions, named after how they store quadrant_index: v1 records keep
+// only its low byte in a uint8_t, 26 bytes in all, wide v3 records keep all of it in a uint16_t, 27 bytes.
+template<typename QuadrantIndex> using paint_struct_record = RecordLayout<
+    RecordField<uint16_t, uint16_t, offsetof(paint_struct, bounds.x)>,
+    RecordField<uint16_t, uint16_t, offsetof(paint_struct, bounds.y)>,
+    RecordField<uint16_t, uint16_t, offsetof(paint_struct, bounds.z)>,
+    RecordField<uint16_t, uint16_t, offsetof(paint_struct, bounds.x_end)>,
+    RecordField<uint16_t, uint16_t, offsetof(paint_struct, bounds.y_end)>,
+    RecordField<uint16_t, uint16_t, offsetof(paint_struct, bounds.z_end)>,
+    RecordField<uint32_t, link_word, offsetof(paint_struct, next_quadrant_ps)>,
+    RecordField<uint8_t, uint8_t, offsetof(paint_struct, quadrant_flags)>,
+    RecordField<QuadrantIndex, uint16_t, offsetof(paint_struct, quadrant_index)>,
+    RecordField<uint16_t, uint16_t, offsetof(paint_struct, x)>,
+    RecordField<uint16_t, uint16_t, offsetof(paint_struct, y)>,
+    RecordField<uint32_t, uint32_t, offsetof(paint_struct, image_id)>>;
+static_assert(paint_struct_record<uint8_t>::Size == 26, "v1 paint struct records are 26 bytes");
+
+using quadrant_record = RecordLayout<RecordField<uint32_t, link_word, 0>>;
+static_assert(sizeof(link_word) == sizeof(paint_session::Quadrants[0]), "quadrant links are stored as raw words");
+
+template<typename QuadrantIndex> static paint_struct read_paint_struct(IStream& ms)
+{
+    paint_struct ps{};
+    ms.ReadRecords<paint_struct_record<QuadrantIndex>>(&ps, 1);
+    return ps;
+}
+
+constexpr uint32_t session_paint_struct_count = sizeof(paint_session::PaintStructs) / sizeof(paint_entry);
+constexpr uint32_t session_quadrant_count = sizeof(paint_session::Quadrants) / sizeof(paint_session::Quadrants[0]);
+
+// One session in records: its structs and head, the quadrant links and both quadrant indices
+template<typename QuadrantIndex>
+constexpr uint64_t session_record_size =
+    (session_paint_struct_count + 1) * paint_struct_record<QuadrantIndex>::Size + session_quadrant_count * 4 + 2 * 4;
+static_assert(session_record_size<uint8_t> == paint_session_record_size, "v1 sessions are paint_session_record_size");
+
+// v1 records mark an empty quadrant with 512, which is also the index of struct 512, so that struct reads back as an
+// empty quadrant. Wide records use 4000, like every other link.
+template<typename QuadrantIndex>
+constexpr uint32_t quadrant_null_index = sizeof(QuadrantIndex) == 1 ? session_quadrant_count : session_paint_struct_count;
+
+using load_clock = std::chrono::steady_clock;
+
+static double milliseconds_since(load_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(load_clock::now() - start).count();
+}
+
+// Resolves a raw index into a link to its struct. `null_index` is the capture's sentinel for an empty link.
+template<typename T> static void resolve_link(paint_session& session, T& link, uint32_t null_index)
+{
+    uint32_t index = get_link_index(link);
+    if (index == null_index)
+    {
+        link = nullptr;
+    }
+    else if (index < std::size(session.PaintStructs))
+    {
+        link = &session.PaintStructs[index].basic;
+    }
+    else
+    {
+        throw IOException("Link index out of range");
+    }
+}
+
+// Narrow records only keep the low byte of quadrant_index, the list a struct is on supplies the rest. Structs whose
+// low byte disagrees with their list are left for validate_session_links() to reject, as are lists that are still
+// going after every struct has been seen, which are cyclic or shared.
+static void restore_quadrant_indices(paint_session& session)
+{
+    size_t budget = session_paint_struct_count;
+    for (uint32_t q = 0; q < session_quadrant_count; q++)
+    {
+        for (paint_struct* ps = session.Quadrants[q]; ps != nullptr; ps = ps->next_quadrant_ps)
+        {
+            if (budget-- == 0)
+            {
+                return;
+            }
+            if ((uint8_t)ps->quadrant_index == (uint8_t)q)
+            {
+                ps->quadrant_index = (uint16_t)q;
+            }
+        }
+    }
+}
+
+// Decodes a session and links it in the same pass: each block of records is linked while it is still in cache.
+// Only the recorded fields are written, `session` is expected to be value-initialised (or a decoded predecessor).
+template<typename QuadrantIndex> static void read_session(IStream& ms, paint_session& session)
+{
+    constexpr size_t block = 256;
+    constexpr size_t structs = session_paint_struct_count;
+    for (size_t first = 0; first < structs; first += block)
+    {
+        size_t n = std::min(block, structs - first);
+        ms.ReadRecords<paint_struct_record<QuadrantIndex>>(session.PaintStructs + first, n);
+        for (size_t j = first; j < first + n; j++)
+        {
+            resolve_link(session, session.PaintStructs[j].basic.next_quadrant_ps, structs);
+        }
+    }
+    ms.ReadRecords<quadrant_record>(session.Quadrants, std::size(session.Quadrants));
+    for (auto& quadrant : session.Quadrants)
+    {
+        resolve_link(session, quadrant, quadrant_null_index<QuadrantIndex>);
+    }
+    ms.ReadRecords<paint_struct_record<QuadrantIndex>>(&session.PaintHead, 1);
+    // Captures store the head's list as a raw 0 and arrange rebuilds it from scratch anyway
+    session.PaintHead.next_quadrant_ps = nullptr;
+    session.QuadrantFrontIndex = ms.ReadValue<uint32_t>();
+    session.QuadrantBackIndex = ms.ReadValue<uint32_t>();
+    if constexpr (sizeof(QuadrantIndex) == 1)
+    {
+        restore_quadrant_indices(session);
+    }
+}
+
+// Applies the records and quadrants that changed since the previous session, see write_session_deltas()
+template<typename QuadrantIndex> static void read_session_delta(IStream& ms, paint_session& session)
+{
+    uint16_t structs = ms.ReadValue<uint16_t>();
+    for (uint16_t i = 0; i < structs; i++)
+    {
+        uint16_t index = ms.ReadValue<uint16_t>();
+        if (index > 4000)
+        {
+            throw IOException("Paint struct index out of range");
+        }
+        paint_struct& ps = index == 4000 ? session.PaintHead : session.PaintStructs[index].basic;
+        ps = read_paint_struct<QuadrantIndex>(ms);
+        if (index == 4000)
+        {
+            ps.next_quadrant_ps = nullptr;
+        }
+        else
+        {
+            resolve_link(session, ps.next_quadrant_ps, 4000);
+        }
+    }
+    uint16_t quadrants = ms.ReadValue<uint16_t>();
+    for (uint16_t i = 0; i < quadrants; i++)
+    {
+        uint16_t index = ms.ReadValue<uint16_t>();
+        if (index >= 512)
+        {
+            throw IOException("Quadrant index out of range");
+        }
+        set_link_index(session.Quadrants[index], ms.ReadValue<uint32_t>());
+        resolve_link(session, session.Quadrants[index], quadrant_null_index<QuadrantIndex>);
+    }
+    session.QuadrantFrontIndex = ms.ReadValue<uint32_t>();
+    session.QuadrantBackIndex = ms.ReadValue<uint32_t>();
+    if constexpr (sizeof(QuadrantIndex) == 1)
+    {
+        restore_quadrant_indices(session);
+    }
+}
+
+static std::vector<paint_session> read_sessions(IStream& ms, load_clock::time_point start, double& first_session_ms)
+{
+    uint32_t sessions_count = ms.ReadValue<uint32_t>();
+    std::vector<paint_session> sessions;
+    // Sessions are value-initialised one at a time, so the first one is ready without zeroing the whole corpus first.
+    // Never trust the count further than the data could go.
+    sessions.reserve(std::min<uint64_t>(sessions_count, (ms.GetLength() - ms.GetPosition()) / paint_session_record_size));
+    for (uint32_t i = 0; i < sessions_count; i++) {
+        read_session<uint8_t>(ms, sessions.emplace_back());
+        if (i == 0)
+        {
+            first_session_ms = milliseconds_since(start);
+        }
+    }
+    return sessions;
+}
+
+#ifndef PSA_COMPRESSED_POINTERS
+template<typename T> static void rebase_link(T*& link, const paint_session& from, paint_session& to)
+{
+    uintptr_t begin = (uintptr_t)&from;
+    if ((uintptr_t)link >= begin && (uintptr_t)link < begin + sizeof(paint_session))
+    {
+        link = (T*)((uintptr_t)&to + ((uintptr_t)link - begin));
+    }
+}
+
+static void rebase_links(paint_struct& ps, const paint_session& from, paint_session& to)
+{
+    rebase_link(ps.attached_ps, from, to);
+    rebase_link(ps.children, from, to);
+    rebase_link(ps.next_quadrant_ps, from, to);
+}
+#endif
+
+// Moves the links of `to`, a copy of `from`, over to the copy. Compressed links are session-relative and stay valid.
+static void rebase_session([[maybe_unused]] const paint_session& from, [[maybe_unused]] paint_session& to)
+{
+#ifndef PSA_COMPRESSED_POINTERS
+    for (auto& entry : to.PaintStructs)
+    {
+        rebase_links(entry.basic, from, to);
+    }
+    for (auto& quadrant : to.Quadrants)
+    {
+        rebase_link(quadrant, from, to);
+    }
+    rebase_links(to.PaintHead, from, to);
+#endif
+}
+
+// Walks every quadrant list once. A struct reached twice is on two lists or on a cycle, either of which would make
+// arrange loop forever or corrupt other lists. Arrange also trusts the quadrant range and that every struct sits on
+// the list of its quadrant_index. Mapped images are only checked here, so links are range checked before anything
+// is read through them.
+static bool validate_session_links(const paint_session& session)
+{
+    constexpr size_t structs = session_paint_struct_count;
+    if (session.QuadrantBackIndex != UINT32_MAX
+        && (session.QuadrantBackIndex > session.QuadrantFrontIndex || session.QuadrantFrontIndex >= session_quadrant_count))
+    {
+        return false;
+    }
+    std::bitset<structs> visited;
+    uintptr_t begin = (uintptr_t)session.PaintStructs;
+    for (uint32_t q = 0; q < session_quadrant_count; q++)
+    {
+        for (const paint_struct* ps = session.Quadrants[q]; ps != nullptr; ps = ps->next_quadrant_ps)
+        {
+            uintptr_t offset = (uintptr_t)ps - begin;
+            size_t index = offset / sizeof(paint_entry);
+            if ((uintptr_t)ps < begin || offset % sizeof(paint_entry) != 0 || index >= structs || visited[index]
+                || ps->quadrant_index != q)
+            {
+                return false;
+            }
+            visited[index] = true;
+        }
+    }
+    return true;
+}
+
+// Everything a capture records about a session, with links as indices so contents compare in either pointer mode.
+// Each struct is passed to `put` as four words.
+template<typename F> static void visit_session_content(const paint_session& session, F put)
+{
+    auto index = [&](const paint_struct* target) {
+        return target == nullptr ? UINT64_MAX : (uint64_t)((const paint_entry*)target - session.PaintStructs);
+    };
+    auto put_struct = [&](const paint_struct& ps) {
+        const auto& bounds = ps.bounds;
+        put((uint64_t)bounds.x | (uint64_t)bounds.y << 16 | (uint64_t)bounds.z << 32 | (uint64_t)bounds.x_end << 48,
+            (uint64_t)bounds.y_end | (uint64_t)bounds.z_end << 16 | (uint64_t)(uint16_t)ps.x << 32 | (uint64_t)(uint16_t)ps.y << 48,
+            (uint64_t)ps.image_id | (uint64_t)ps.quadrant_index << 32 | (uint64_t)ps.quadrant_flags << 48,
+            index(ps.next_quadrant_ps));
+    };
+    for (const auto& entry : session.PaintStructs)
+    {
+        put_struct(entry.basic);
+    }
+    put_struct(session.PaintHead);
+    for (size_t q = 0; q < std::size(session.Quadrants); q += 4)
+    {
+        put(index(session.Quadrants[q]), index(session.Quadrants[q + 1]), index(session.Quadrants[q + 2]),
+            index(session.Quadrants[q + 3]));
+    }
+    put(session.QuadrantBackIndex, session.QuadrantFrontIndex, session.CurrentRotation, 0);
+}
+
+static_assert(session_quadrant_count % 4 == 0, "quadrants are visited four at a time");
+
+// Four independent lanes, so the multiplies of consecutive words overlap
+static uint64_t hash_session_content(const paint_session& session)
+{
+    uint64_t lanes[4] = { 0x9E3779B97F4A7C15, 0xC2B2AE3D27D4EB4F, 0x165667B19E3779F9, 0x27D4EB2F165667C5 };
+    visit_session_content(session, [&](uint64_t a, uint64_t b, uint64_t c, uint64_t d) {
+        lanes[0] = (lanes[0] ^ a) * 0xFF51AFD7ED558CCD;
+        lanes[1] = (lanes[1] ^ b) * 0xFF51AFD7ED558CCD;
+        lanes[2] = (lanes[2] ^ c) * 0xFF51AFD7ED558CCD;
+        lanes[3] = (lanes[3] ^ d) * 0xFF51AFD7ED558CCD;
+        lanes[0] ^= lanes[0] >> 32;
+        lanes[1] ^= lanes[1] >> 32;
+        lanes[2] ^= lanes[2] >> 32;
+        lanes[3] ^= lanes[3] >> 32;
+    });
+    return lanes[0] ^ (lanes[1] * 3) ^ (lanes[2] * 5) ^ (lanes[3] * 7);
+}
+
+// The same content visit_session_content() hashes, compared field by field
+static bool same_session_content(const paint_session& a, const paint_session& b)
+{
+    auto same_link = [&](const paint_struct* x, const paint_struct* y) {
+        return x == nullptr ? y == nullptr : y != nullptr && (const paint_entry*)x - a.PaintStructs == (const paint_entry*)y - b.PaintStructs;
+    };
+    auto same_struct = [&](const paint_struct& x, const paint_struct& y) {
+        return x.bounds.x == y.bounds.x && x.bounds.y == y.bounds.y && x.bounds.z == y.bounds.z && x.bounds.x_end == y.bounds.x_end
+            && x.bounds.y_end == y.bounds.y_end && x.bounds.z_end == y.bounds.z_end && x.x == y.x && x.y == y.y
+            && x.image_id == y.image_id && x.quadrant_index == y.quadrant_index && x.quadrant_flags == y.quadrant_flags
+            && same_link(x.next_quadrant_ps, y.next_quadrant_ps);
+    };
+    for (size_t i = 0; i < session_paint_struct_count; i++)
+    {
+        if (!same_struct(a.PaintStructs[i].basic, b.PaintStructs[i].basic))
+        {
+            return false;
+        }
+    }
+    for (size_t q = 0; q < session_quadrant_count; q++)
+    {
+        if (!same_link(a.Quadrants[q], b.Quadrants[q]))
+        {
+            return false;
+        }
+    }
+    return same_struct(a.PaintHead, b.PaintHead) && a.QuadrantBackIndex == b.QuadrantBackIndex
+        && a.QuadrantFrontIndex == b.QuadrantFrontIndex && a.CurrentRotation == b.CurrentRotation;
+}
+
+size_t paint_corpus_differing_sessions(const paint_corpus& a, const paint_corpus& b)
+{
+    size_t common = std::min(a.sessions.size(), b.sessions.size());
+    size_t differing = std::max(a.sessions.size(), b.sessions.size()) - common;
+    for (size_t i = 0; i < common; i++)
+    {
+        differing += !same_session_content(a.sessions[i], b.sessions[i]);
+    }
+    return differing;
+}
+
+// Keeps the first of every run of identical sessions, idle and paused parks record the same frame over and over.
+// Returns which stored session each one became, or nothing if all of them are distinct and `sessions` is untouched.
+static std::vector<uint32_t> deduplicate_sessions(std::vector<paint_session>& sessions)
+{
+    std::unordered_multimap<uint64_t, uint32_t> stored_by_hash;
+    std::vector<uint32_t> stored;
+    std::vector<uint32_t> order(sessions.size());
+    for (uint32_t i = 0; i < sessions.size(); i++)
+    {
+        uint64_t hash = hash_session_content(sessions[i]);
+        order[i] = (uint32_t)stored.size();
+        auto range = stored_by_hash.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            // Hashes only pick the candidates, equal contents decide
+            if (same_session_content(sessions[stored[it->second]], sessions[i]))
+            {
+                order[i] = it->second;
+                break;
+            }
+        }
+        if (order[i] == stored.size())
+        {
+            stored_by_hash.emplace(hash, order[i]);
+            stored.push_back(i);
+        }
+    }
+    if (stored.size() == sessions.size())
+    {
+        return {};
+    }
+    std::vector<paint_session> unique;
+    // Reserved up front, so links moved into a session stay put
+    unique.reserve(stored.size());
+    for (uint32_t index : stored)
+    {
+        rebase_session(sessions[index], unique.emplace_back(sessions[index]));
+    }
+    sessions = std::move(unique);
+    return order;
+}
+
+static std::shared_ptr<paint_corpus> make_corpus(
+    std::string name, std::string park, std::vector<paint_session> sessions, bool deduplicate, std::ostream& log)
+{
+    auto corpus = std::make_shared<paint_corpus>();
+    corpus->name = std::move(name);
+    corpus->park = std::move(park);
+    std::vector<uint32_t> order;
+    if (deduplicate)
+    {
+        auto start = load_clock::now();
+        order = deduplicate_sessions(sessions);
+        if (!order.empty())
+        {
+            log << "Stored " << sessions.size() << " unique of " << order.size() << " sessions, deduplicated in "
+                << milliseconds_since(start) << " ms" << std::endl;
+        }
+    }
+    corpus->sessions = paint_session_set(std::move(sessions), std::move(order));
+    return corpus;
+}
+
+// Loaders only range check links, lists are validated once here as everything after loading follows them unchecked
+static paint_corpus_ptr validate_corpus(std::shared_ptr<paint_corpus> corpus, std::ostream& log)
+{
+    if (corpus == nullptr)
+    {
+        return nullptr;
+    }
+    auto start = load_clock::now();
+    for (size_t i = 0; i < corpus->sessions.size(); i++)
+    {
+        if (!validate_session_links(corpus->sessions[i]))
+        {
+            log << "Invalid capture " << corpus->name << ": session " << i << " has a broken quadrant list"
+                << std::endl;
+            return nullptr;
+        }
+    }
+    corpus->link_validation_ms = milliseconds_since(start);
+    log << "Validated links in " << corpus->link_validation_ms << " ms" << std::endl;
+    return corpus;
+}
+
+static std::vector<paint_session> extract_paint_session(const char* fname, const MappedFile& file, std::string& park, std::ostream& log)
+{
+    auto start = load_clock::now();
+    // The compressed data is mapped and inflated in bounded chunks while sessions are decoded,
+    // so neither the compressed nor the inflated file is ever held in memory as a whole.
+    if (file.GetSize() < 4)
+    {
+        log << "Could not read " << fname << std::endl;
+        return {};
+    }
+    uint32_t cb;
+    std::memcpy(&cb, file.GetData(), sizeof(cb));
+    std::vector<paint_session> sessions;
+    double first_session_ms = 0;
+    try
+    {
+        InflateStream ms(file.GetData() + 4, file.GetSize() - 4, cb);
+        std::string version = ms.ReadStdString();
+        if (version != "paint session v1") {
+            log << "Invalid version: " << version << std::endl;
+            return {};
+        }
+        park = ms.ReadStdString();
+        sessions = read_sessions(ms, start, first_session_ms);
+        if (!ms.AtEnd())
+        {
+            log << "Invalid decompressed size " << cb << ", consumed " << ms.GetPosition() << std::endl;
+            return {};
+        }
+    }
+    catch (const IOException& e)
+    {
+        log << "Invalid capture " << fname << ": " << e.what() << std::endl;
+        return {};
+    }
+    log << "Park " << park << " has " << sessions.size() << " sessions, first decoded after " << first_session_ms
+              << " ms" << std::endl;
+    return sessions;
+}
+
+// v2 captures: a header, then one uncompressed session image per 256KiB window starting at `session_offset`.
+// Images use the compressed-link layout, links are byte offsets from the start of their session and 0 is null.
+// The header records where every session field lives, so builds with another layout can still decode the file.
+struct psa_v2_header
+{
+    char magic[16];
+    uint32_t header_size;
+    uint32_t session_count;
+    uint32_t session_offset;
+    uint32_t session_stride;
+    uint32_t paint_structs_offset;
+    uint32_t paint_struct_stride;
+    uint32_t paint_struct_count;
+    uint32_t quadrants_offset;
+    uint32_t quadrant_count;
+    uint32_t paint_head_offset;
+    uint32_t quadrant_back_index_offset;
+    uint32_t quadrant_front_index_offset;
+    uint32_t current_rotation_offset;
+    uint32_t park_length; // followed by the park name
+};
+
+static constexpr char psa_v2_magic[16] = { 'p', 'a', 'i', 'n', 't', ' ', 's', 'e', 's', 's', 'i', 'o', 'n', ' ', 'v', '2' };
+// A multiple of both the page size and the Windows allocation granularity, so images can be mapped directly
+constexpr uint32_t psa_v2_session_offset = 0x10000;
+constexpr uint32_t psa_v2_session_stride = 0x40000;
+
+// Field offsets of the 0x34 byte paint_struct layout used by the images
+enum : uint32_t
+{
+    PS_IMAGE_ID = 0x00,
+    PS_COLOUR_IMAGE_ID = 0x04,
+    PS_BOUNDS = 0x08,
+    PS_X = 0x14,
+    PS_Y = 0x16,
+    PS_QUADRANT_INDEX = 0x18,
+    PS_FLAGS = 0x1A,
+    PS_QUADRANT_FLAGS = 0x1B,
+    PS_NEXT_QUADRANT_PS = 0x24,
+    PS_SPRITE_TYPE = 0x28,
+    PS_VAR_29 = 0x29,
+    PS_MAP_X = 0x2C,
+    PS_MAP_Y = 0x2E,
+    PS_SIZE = 0x34,
+};
+
+#ifdef PSA_COMPRESSED_POINTERS
+static_assert(offsetof(paint_struct, bounds) == PS_BOUNDS && offsetof(paint_struct, quadrant_index) == PS_QUADRANT_INDEX
+        && offsetof(paint_struct, next_quadrant_ps) == PS_NEXT_QUADRANT_PS && offsetof(paint_struct, map_y) == PS_MAP_Y,
+    "v2 images are compressed-link sessions as they are in memory");
+
+static psa_v2_header make_v2_header()
+{
+    psa_v2_header header{};
+    std::memcpy(header.magic, psa_v2_magic, sizeof(header.magic));
+    header.header_size = sizeof(psa_v2_header);
+    header.session_offset = psa_v2_session_offset;
+    header.session_stride = sizeof(paint_session);
+    header.paint_structs_offset = offsetof(paint_session, PaintStructs);
+    header.paint_struct_stride = sizeof(paint_entry);
+    header.paint_struct_count = session_paint_struct_count;
+    header.quadrants_offset = offsetof(paint_session, Quadrants);
+    header.quadrant_count = session_quadrant_count;
+    header.paint_head_offset = offsetof(paint_session, PaintHead);
+    header.quadrant_back_index_offset = offsetof(paint_session, QuadrantBackIndex);
+    header.quadrant_front_index_offset = offsetof(paint_session, QuadrantFrontIndex);
+    header.current_rotation_offset = offsetof(paint_session, CurrentRotation);
+    return header;
+}
+#endif
+
+template<typename T> static T read_image(const uint8_t* image, uint32_t offset)
+{
+    T value;
+    std::memcpy(&value, image + offset, sizeof(value));
+    return value;
+}
+
+// Resolves an image link to the struct it names, rejecting anything that is not the start of a struct
+static bool resolve_v2_link(const psa_v2_header& header, paint_session& session, uint32_t link, paint_struct*& target)
+{
+    target = nullptr;
+    if (link == 0)
+    {
+        return true;
+    }
+    uint32_t relative = link - header.paint_structs_offset;
+    if (link < header.paint_structs_offset || relative % header.paint_struct_stride != 0
+        || relative / header.paint_struct_stride >= header.paint_struct_count)
+    {
+        return false;
+    }
+    target = &session.PaintStructs[relative / header.paint_struct_stride].basic;
+    return true;
+}
+
+static bool decode_v2_paint_struct(const psa_v2_header& header, const uint8_t* image, uint32_t offset, paint_session& session, paint_struct& ps)
+{
+    const uint8_t* src = image + offset;
+    ps.image_id = read_image<uint32_t>(src, PS_IMAGE_ID);
+    ps.colour_image_id = read_image<uint32_t>(src, PS_COLOUR_IMAGE_ID);
+    ps.bounds = read_image<paint_struct_bound_box>(src, PS_BOUNDS);
+    ps.x = read_image<uint16_t>(src, PS_X);
+    ps.y = read_image<uint16_t>(src, PS_Y);
+    ps.quadrant_index = read_image<uint16_t>(src, PS_QUADRANT_INDEX);
+    ps.flags = read_image<uint8_t>(src, PS_FLAGS);
+    ps.quadrant_flags = read_image<uint8_t>(src, PS_QUADRANT_FLAGS);
+    ps.sprite_type = read_image<uint8_t>(src, PS_SPRITE_TYPE);
+    ps.var_29 = read_image<uint8_t>(src, PS_VAR_29);
+    ps.map_x = read_image<uint16_t>(src, PS_MAP_X);
+    ps.map_y = read_image<uint16_t>(src, PS_MAP_Y);
+    paint_struct* next;
+    if (!resolve_v2_link(header, session, read_image<uint32_t>(src, PS_NEXT_QUADRANT_PS), next))
+    {
+        return false;
+    }
+    ps.next_quadrant_ps = next;
+    return true;
+}
+
+// Builds a session of this build's layout from an image, for builds that cannot use the image in place
+static bool decode_v2_session(const psa_v2_header& header, const uint8_t* image, paint_session& session)
+{
+    for (uint32_t j = 0; j < header.paint_struct_count; j++)
+    {
+        uint32_t offset = header.paint_structs_offset + j * header.paint_struct_stride;
+        if (!decode_v2_paint_struct(header, image, offset, session, session.PaintStructs[j].basic))
+        {
+            return false;
+        }
+    }
+    for (uint32_t j = 0; j < header.quadrant_count; j++)
+    {
+        paint_struct* quadrant;
+        if (!resolve_v2_link(header, session, read_image<uint32_t>(image, header.quadrants_offset + j * 4), quadrant))
+        {
+            return false;
+        }
+        session.Quadrants[j] = quadrant;
+    }
+    session.QuadrantBackIndex = read_image<uint32_t>(image, header.quadrant_back_index_offset);
+    session.QuadrantFrontIndex = read_image<uint32_t>(image, header.quadrant_front_index_offset);
+    session.CurrentRotation = read_image<uint8_t>(image, header.current_rotation_offset);
+    return decode_v2_paint_struct(header, image, header.paint_head_offset, session, session.PaintHead);
+}
+
+static bool is_v2(const MappedFile& file)
+{
+    return file.GetSize() >= sizeof(psa_v2_magic) && std::memcmp(file.GetData(), psa_v2_magic, sizeof(psa_v2_magic)) == 0;
+}
+
+static bool read_v2_header(const char* fname, const MappedFile& file, psa_v2_header& header, std::string& park, std::ostream& log)
+{
+    if (file.GetSize() < sizeof(header))
+    {
+        log << "Invalid capture " << fname << ": truncated v2 header" << std::endl;
+        return false;
+    }
+    std::memcpy(&header, file.GetData(), sizeof(header));
+    auto field_fits = [&](uint32_t offset, uint64_t size) { return offset + size <= header.session_stride; };
+    if (header.header_size < sizeof(header) || (uint64_t)header.header_size + header.park_length > header.session_offset
+        || header.session_offset % psa_v2_session_offset != 0 || header.session_stride != psa_v2_session_stride
+        || header.paint_struct_stride != PS_SIZE || header.paint_struct_count != session_paint_struct_count
+        || header.quadrant_count != session_quadrant_count
+        || !field_fits(header.paint_structs_offset, (uint64_t)header.paint_struct_count * header.paint_struct_stride)
+        || !field_fits(header.quadrants_offset, (uint64_t)header.quadrant_count * 4) || !field_fits(header.paint_head_offset, PS_SIZE)
+        || !field_fits(header.quadrant_back_index_offset, 4) || !field_fits(header.quadrant_front_index_offset, 4)
+        || !field_fits(header.current_rotation_offset, 1))
+    {
+        log << "Invalid capture " << fname << ": unsupported v2 layout" << std::endl;
+        return false;
+    }
+    if (header.session_offset + (uint64_t)header.session_count * header.session_stride > file.GetSize())
+    {
+        log << "Invalid capture " << fname << ": " << header.session_count << " sessions do not fit the file" << std::endl;
+        return false;
+    }
+    park.assign((const char*)file.GetData() + header.header_size, header.park_length);
+    return true;
+}
+
+static std::shared_ptr<paint_corpus> load_v2(
+    const char* fname, const MappedFile& file, load_clock::time_point start, const paint_corpus_load_options& options, std::ostream& log)
+{
+    psa_v2_header header;
+    auto corpus = std::make_shared<paint_corpus>();
+    corpus->name = fname;
+    if (!read_v2_header(fname, file, header, corpus->park, log) || header.session_count == 0)
+    {
+        return nullptr;
+    }
+#ifdef PSA_COMPRESSED_POINTERS
+    psa_v2_header native = make_v2_header();
+    native.session_count = header.session_count;
+    native.park_length = header.park_length;
+    // Same layout as ours: the images are the sessions, map them and be done
+    if (std::memcmp(&native, &header, sizeof(header)) == 0)
+    {
+        auto image = std::make_shared<MappedFile>(fname, header.session_offset, PAINT_SESSION_ALIGNMENT, false);
+        if (image->IsOpen())
+        {
+            corpus->sessions = paint_session_set(std::move(image), header.session_count);
+            corpus->image_offset = header.session_offset;
+            log << "Mapped " << fname << " (" << header.session_count << " sessions) in " << milliseconds_since(start)
+                      << " ms" << std::endl;
+            return corpus;
+        }
+    }
+#endif
+    std::vector<paint_session> sessions;
+    // Reserved up front, so links resolved into a session stay put
+    sessions.reserve(header.session_count);
+    for (uint32_t i = 0; i < header.session_count; i++)
+    {
+        const uint8_t* image = file.GetData() + header.session_offset + (uint64_t)i * header.session_stride;
+        if (!decode_v2_session(header, image, sessions.emplace_back()))
+        {
+            log << "Invalid capture " << fname << ": session " << i << " links outside its paint structs" << std::endl;
+            return nullptr;
+        }
+    }
+    log << "Decoded " << fname << " (" << header.session_count << " sessions) in " << milliseconds_since(start)
+              << " ms" << std::endl;
+    return make_corpus(fname, std::move(corpus->park), std::move(sessions), options.deduplicate, log);
+}
+
+#ifdef PSA_COMPRESSED_POINTERS
+// Host pointers mean nothing to whoever maps the image later, so the written copy leaves them null
+static void clear_host_pointers(paint_session& session)
+{
+    session.DPI.bits = nullptr;
+    session.DPI.DrawingEngine = nullptr;
+    session.CurrentlyDrawnItem = nullptr;
+    session.SurfaceElement = nullptr;
+    session.PathElementOnSameHeight = nullptr;
+    session.TrackElementOnSameHeight = nullptr;
+}
+#endif
+
+bool paint_corpus_write_v2([[maybe_unused]] const paint_corpus& corpus, [[maybe_unused]] const char* fname)
+{
+#ifdef PSA_COMPRESSED_POINTERS
+    psa_v2_header header = make_v2_header();
+    header.session_count = (uint32_t)corpus.sessions.size();
+    header.park_length = (uint32_t)corpus.park.size();
+    if (header.header_size + header.park_length > header.session_offset)
+    {
+        std::cout << "Park name too long for " << fname << std::endl;
+        return false;
+    }
+    FILE* file = fopen(fname, "wb");
+    if (file == nullptr)
+    {
+        std::cout << "Could not write " << fname << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> prologue(header.session_offset);
+    std::memcpy(prologue.data(), &header, sizeof(header));
+    std::memcpy(prologue.data() + sizeof(header), corpus.park.data(), corpus.park.size());
+    bool ok = fwrite(prologue.data(), prologue.size(), 1, file) == 1;
+    auto image = std::make_unique<paint_session>();
+    for (const paint_session& session : corpus.sessions)
+    {
+        // Compressed links are session-relative, so a byte copy keeps them valid
+        std::memcpy((void*)image.get(), &session, sizeof(session));
+        clear_host_pointers(*image);
+        ok = ok && fwrite(image.get(), sizeof(*image), 1, file) == 1;
+    }
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+    {
+        std::cout << "Could not write " << fname << std::endl;
+        return false;
+    }
+    std::cout << "Wrote " << header.session_count << " sessions to " << fname << std::endl;
+    return true;
+#else
+    std::cout << "Writing v2 captures needs a build with WITH_COMPRESSED_POINTERS" << std::endl;
+    return false;
+#endif
+}
+
+// v3 captures: a header, the park name and a frame table, then independently deflated frames of up to
+// `frame_sessions` consecutive sessions each. Frames inflate on any thread and in any order.
+struct psa_v3_header
+{
+    char magic[16];
+    uint32_t header_size;
+    uint32_t session_count;
+    uint32_t frame_count;
+    uint32_t frame_sessions;
+    uint32_t encoding;
+    uint32_t park_length; // followed by the park name and frame_count psa_v3_frame entries
+    // File offset of one CurrentRotation byte per session, 0 if every session is seen from rotation 0.
+    // Captures written before it existed have a shorter header.
+    uint64_t rotation_offset;
+    // Bytes each quadrant_index takes in records and delta frames, 1 or 2. A single byte, as in v1 records, only keeps the
+    // low byte, and an empty quadrant is stored as 512 instead of 4000. Captures written before this field existed
+    // used 1.
+    uint32_t quadrant_index_size;
+    uint32_t reserved;
+};
+
+struct psa_v3_frame
+{
+    uint64_t offset;
+    uint32_t compressed_size;
+    uint32_t uncompressed_size;
+};
+
+static constexpr char psa_v3_magic[16] = { 'p', 'a', 'i', 'n', 't', ' ', 's', 'e', 's', 's', 'i', 'o', 'n', ' ', 'v', '3' };
+
+// Runs work(i) for every i in [0, count) on up to `threads` threads, 0 meaning one per core
+template<typename F> static void parallel_for(size_t count, unsigned threads, F work)
+{
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = (unsigned)std::min<size_t>(threads, count);
+    std::atomic<size_t> next{ 0 };
+    auto worker = [&] {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count;)
+        {
+            work(i);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++)
+    {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool)
+    {
+        thread.join();
+    }
+}
+
+static bool is_v3(const MappedFile& file)
+{
+    return file.GetSize() >= sizeof(psa_v3_magic) && std::memcmp(file.GetData(), psa_v3_magic, sizeof(psa_v3_magic)) == 0;
+}
+
+static uint64_t v3_session_record_size(const psa_v3_header& header)
+{
+    return header.quadrant_index_size == 2 ? session_record_size<uint16_t> : session_record_size<uint8_t>;
+}
+
+// Deflate never expands by more than about 1032:1
+constexpr uint64_t deflate_max_ratio = 1032;
+// A delta session that changed nothing still stores both counts and both quadrant indices
+constexpr uint64_t delta_session_min_size = 2 + 2 + 2 * 4;
+
+static bool read_v3_header(
+    const char* fname, const MappedFile& file, psa_v3_header& header, std::string& park, const psa_v3_frame*& frames, std::ostream& log)
+{
+    if (file.GetSize() < offsetof(psa_v3_header, rotation_offset))
+    {
+        log << "Invalid capture " << fname << ": truncated v3 header" << std::endl;
+        return false;
+    }
+    header = {};
+    std::memcpy(&header, file.GetData(), offsetof(psa_v3_header, rotation_offset));
+    // Fields added since stay zero for captures written before them
+    std::memcpy(&header, file.GetData(), (size_t)std::min<uint64_t>({ header.header_size, sizeof(header), file.GetSize() }));
+    if (header.quadrant_index_size == 0)
+    {
+        header.quadrant_index_size = 1;
+    }
+    uint64_t table = (uint64_t)header.header_size + header.park_length;
+    if (header.header_size < offsetof(psa_v3_header, rotation_offset) || header.encoding > (uint32_t)paint_frame_encoding::delta
+        || header.quadrant_index_size > 2
+        || header.frame_sessions == 0 || header.frame_count != ((uint64_t)header.session_count + header.frame_sessions - 1) / header.frame_sessions
+        || table % alignof(psa_v3_frame) != 0 || table + (uint64_t)header.frame_count * sizeof(psa_v3_frame) > file.GetSize())
+    {
+        log << "Invalid capture " << fname << ": unsupported v3 header" << std::endl;
+        return false;
+    }
+    if (header.rotation_offset != 0)
+    {
+        // Bounds first, the table is only read once it is known to lie past the frame table and inside the file
+        uint64_t table_end = table + (uint64_t)header.frame_count * sizeof(psa_v3_frame);
+        if (header.rotation_offset < table_end || header.rotation_offset > file.GetSize()
+            || header.session_count > file.GetSize() - header.rotation_offset
+            || std::any_of(file.GetData() + header.rotation_offset, file.GetData() + header.rotation_offset + header.session_count,
+                [](uint8_t rotation) { return rotation > 3; }))
+        {
+            log << "Invalid capture " << fname << ": bad rotation table" << std::endl;
+            return false;
+        }
+    }
+    frames = (const psa_v3_frame*)(file.GetData() + table);
+    for (uint32_t f = 0; f < header.frame_count; f++)
+    {
+        uint64_t sessions = std::min<uint64_t>(header.frame_sessions, header.session_count - (uint64_t)f * header.frame_sessions);
+        uint64_t size = frames[f].uncompressed_size;
+        if (header.encoding == (uint32_t)paint_frame_encoding::records)
+        {
+            size = sessions * v3_session_record_size(header);
+        }
+        else if (header.encoding == (uint32_t)paint_frame_encoding::columnar)
+        {
+            size = paint_columns_size(sessions);
+        }
+        bool short_delta = header.encoding == (uint32_t)paint_frame_encoding::delta
+            && size < v3_session_record_size(header) + (sessions - 1) * delta_session_min_size;
+        // Nothing inflates beyond deflate's best ratio, so a frame claiming more is corrupt rather than worth allocating
+        if (frames[f].offset > file.GetSize() || frames[f].compressed_size > file.GetSize() - frames[f].offset
+            || frames[f].uncompressed_size != size || short_delta || size > frames[f].compressed_size * deflate_max_ratio)
+        {
+            log << "Invalid capture " << fname << ": frame " << f << " does not fit the file" << std::endl;
+            return false;
+        }
+    }
+    park.assign((const char*)file.GetData() + header.header_size, header.park_length);
+    return true;
+}
+
+// Decodes `count` sessions from `first` on out of an inflated records or delta frame
+template<typename QuadrantIndex>
+static void read_v3_records(IStream& ms, const psa_v3_header& header, uint32_t first, uint32_t count, paint_session* sessions)
+{
+    if (header.encoding == (uint32_t)paint_frame_encoding::delta)
+    {
+        // Every session builds on its predecessor, so the frame is replayed from its keyframe up to the last one wanted.
+        // Sessions before `first` are rebuilt in place in sessions[0].
+        for (uint32_t k = 0; k < first + count; k++)
+        {
+            paint_session& session = sessions[k > first ? k - first : 0];
+            if (k > first)
+            {
+                session = sessions[k - first - 1];
+                rebase_session(sessions[k - first - 1], session);
+            }
+            if (k == 0)
+            {
+                read_session<QuadrantIndex>(ms, session);
+            }
+            else
+            {
+                read_session_delta<QuadrantIndex>(ms, session);
+            }
+        }
+        return;
+    }
+    ms.Seek(first * session_record_size<QuadrantIndex>, ISTREAM_SEEK_CURRENT);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        read_session<QuadrantIndex>(ms, sessions[i]);
+    }
+}
+
+// Inflates frame `f` and decodes `count` of its sessions from `first` on into `sessions`, links resolved
+static void inflate_v3_frame(const MappedFile& file, const psa_v3_header& header, const psa_v3_frame* frames, uint32_t f,
+    uint32_t first, uint32_t count, paint_session* sessions)
+{
+    const psa_v3_frame& frame = frames[f];
+    InflateStream ms(file.GetData() + frame.offset, frame.compressed_size, frame.uncompressed_size);
+    if (header.encoding == (uint32_t)paint_frame_encoding::columnar)
+    {
+        uint32_t frame_sessions = std::min(header.frame_sessions, header.session_count - f * header.frame_sessions);
+        std::vector<uint8_t> columns(frame.uncompressed_size);
+        ms.Read(columns.data(), columns.size());
+        if (!paint_columns_decode(columns.data(), columns.size(), frame_sessions, first, sessions, count))
+        {
+            throw IOException("Link outside of its session");
+        }
+        return;
+    }
+    if (header.quadrant_index_size == 2)
+    {
+        read_v3_records<uint16_t>(ms, header, first, count, sessions);
+    }
+    else
+    {
+        read_v3_records<uint8_t>(ms, header, first, count, sessions);
+    }
+}
+
+// inflate_v3_frame() plus the rotation of each session, which frames do not record themselves
+static void read_v3_frame(const MappedFile& file, const psa_v3_header& header, const psa_v3_frame* frames, uint32_t f,
+    uint32_t first, uint32_t count, paint_session* sessions)
+{
+    inflate_v3_frame(file, header, frames, f, first, count, sessions);
+    if (header.rotation_offset != 0)
+    {
+        const uint8_t* rotations = file.GetData() + header.rotation_offset + (uint64_t)f * header.frame_sessions + first;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            sessions[i].CurrentRotation = rotations[i];
+        }
+    }
+}
+
+static std::shared_ptr<paint_corpus> load_v3(
+    const char* fname, const MappedFile& file, load_clock::time_point start, const paint_corpus_load_options& options, std::ostream& log)
+{
+    psa_v3_header header;
+    const psa_v3_frame* frames;
+    std::string park;
+    if (!read_v3_header(fname, file, header, park, frames, log) || header.session_count == 0)
+    {
+        return nullptr;
+    }
+    std::vector<paint_session> sessions(header.session_count);
+    std::atomic<bool> failed{ false };
+    parallel_for(header.frame_count, options.threads, [&](size_t f) {
+        uint32_t first = (uint32_t)f * header.frame_sessions;
+        uint32_t count = std::min(header.frame_sessions, header.session_count - first);
+        try
+        {
+            read_v3_frame(file, header, frames, (uint32_t)f, 0, count, &sessions[first]);
+        }
+        catch (const IOException&)
+        {
+            failed = true;
+        }
+    });
+    if (failed)
+    {
+        log << "Invalid capture " << fname << ": corrupt frame" << std::endl;
+        return nullptr;
+    }
+    log << "Loaded " << fname << " (" << header.session_count << " sessions in " << header.frame_count << " frames) in "
+        << milliseconds_since(start) << " ms" << std::endl;
+    return make_corpus(fname, std::move(park), std::move(sessions), options.deduplicate, log);
+}
+
+static uint32_t link_index(const paint_session& session, const paint_struct* target, uint32_t null_index)
+{
+    return target == nullptr ? null_index : (uint32_t)((const paint_entry*)target - session.PaintStructs);
+}
+
+template<typename QuadrantIndex>
+static void write_paint_struct(IStream& ms, const paint_session& session, const paint_struct& ps, uint32_t null_index)
+{
+    ms.WriteValue<uint16_t>(ps.bounds.x);
+    ms.WriteValue<uint16_t>(ps.bounds.y);
+    ms.WriteValue<uint16_t>(ps.bounds.z);
+    ms.WriteValue<uint16_t>(ps.bounds.x_end);
+    ms.WriteValue<uint16_t>(ps.bounds.y_end);
+    ms.WriteValue<uint16_t>(ps.bounds.z_end);
+    ms.WriteValue<uint32_t>(link_index(session, ps.next_quadrant_ps, null_index));
+    ms.WriteValue<uint8_t>(ps.quadrant_flags);
+    ms.WriteValue<QuadrantIndex>((QuadrantIndex)ps.quadrant_index);
+    ms.WriteValue<uint16_t>(ps.x);
+    ms.WriteValue<uint16_t>(ps.y);
+    ms.WriteValue<uint32_t>(ps.image_id);
+}
+
+template<typename QuadrantIndex> static void write_session(IStream& ms, const paint_session& session)
+{
+    for (const auto& entry : session.PaintStructs)
+    {
+        write_paint_struct<QuadrantIndex>(ms, session, entry.basic, session_paint_struct_count);
+    }
+    for (const auto& quadrant : session.Quadrants)
+    {
+        ms.WriteValue<uint32_t>(link_index(session, quadrant, quadrant_null_index<QuadrantIndex>));
+    }
+    // The head's list is never linked on load, so it is stored as a raw 0 as in v1 captures
+    write_paint_struct<QuadrantIndex>(ms, session, session.PaintHead, 0);
+    ms.WriteValue<uint32_t>(session.QuadrantFrontIndex);
+    ms.WriteValue<uint32_t>(session.QuadrantBackIndex);
+}
+
+// The first session of a frame is stored in full. Every later one only stores the struct records and quadrants
+// that differ from its predecessor, each prefixed by its index (4000 for the head), and both quadrant indices.
+template<typename QuadrantIndex>
+static void write_session_deltas(IStream& ms, const paint_session* const* sessions, uint32_t count)
+{
+    constexpr size_t struct_size = paint_struct_record<QuadrantIndex>::Size;
+    constexpr size_t quadrants_begin = 4000 * struct_size;
+    constexpr size_t head_begin = quadrants_begin + 512 * 4;
+    auto record = [](const paint_session& session) {
+        MemoryStream image(session_record_size<QuadrantIndex>);
+        write_session<QuadrantIndex>(image, session);
+        return std::vector<uint8_t>((const uint8_t*)image.GetData(), (const uint8_t*)image.GetData() + image.GetLength());
+    };
+    std::vector<uint8_t> previous = record(*sessions[0]);
+    ms.Write(previous.data(), previous.size());
+    for (uint32_t i = 1; i < count; i++)
+    {
+        std::vector<uint8_t> current = record(*sessions[i]);
+        const uint8_t* before = previous.data();
+        const uint8_t* after = current.data();
+        std::vector<uint16_t> changed;
+        for (uint16_t j = 0; j <= 4000; j++)
+        {
+            size_t offset = j < 4000 ? j * struct_size : head_begin;
+            if (std::memcmp(before + offset, after + offset, struct_size) != 0)
+            {
+                changed.push_back(j);
+            }
+        }
+        ms.WriteValue<uint16_t>((uint16_t)changed.size());
+        for (uint16_t j : changed)
+        {
+            ms.WriteValue<uint16_t>(j);
+            ms.Write(after + (j < 4000 ? j * struct_size : head_begin), struct_size);
+        }
+        changed.clear();
+        for (uint16_t q = 0; q < 512; q++)
+        {
+            if (std::memcmp(before + quadrants_begin + q * 4, after + quadrants_begin + q * 4, 4) != 0)
+            {
+                changed.push_back(q);
+            }
+        }
+        ms.WriteValue<uint16_t>((uint16_t)changed.size());
+        for (uint16_t q : changed)
+        {
+            ms.WriteValue<uint16_t>(q);
+            ms.Write(after + quadrants_begin + q * 4, 4);
+        }
+        ms.Write(after + head_begin + struct_size, 2 * 4);
+        previous = std::move(current);
+    }
+}
+
+bool paint_corpus_write_v3(const paint_corpus& corpus, const char* fname, const paint_capture_options& options)
+{
+    psa_v3_header header{};
+    std::memcpy(header.magic, psa_v3_magic, sizeof(header.magic));
+    header.header_size = sizeof(header);
+    header.session_count = (uint32_t)corpus.sessions.size();
+    header.frame_sessions = std::max(1u, options.frame_sessions);
+    header.frame_count = (header.session_count + header.frame_sessions - 1) / header.frame_sessions;
+    header.encoding = (uint32_t)options.encoding;
+    header.quadrant_index_size = 2;
+    // Padded so the frame table that follows the name stays aligned
+    std::string park = corpus.park;
+    park.resize((park.size() + alignof(psa_v3_frame) - 1) & ~(alignof(psa_v3_frame) - 1));
+    header.park_length = (uint32_t)park.size();
+
+    std::vector<std::vector<uint8_t>> compressed(header.frame_count);
+    std::vector<psa_v3_frame> frames(header.frame_count);
+    parallel_for(header.frame_count, options.threads, [&](size_t f) {
+        uint32_t first = (uint32_t)f * header.frame_sessions;
+        uint32_t count = std::min(header.frame_sessions, header.session_count - first);
+        std::vector<const paint_session*> sessions;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            sessions.push_back(&corpus.sessions[first + i]);
+        }
+        std::vector<uint8_t> data;
+        if (options.encoding == paint_frame_encoding::columnar)
+        {
+            paint_columns_encode(sessions.data(), count, data);
+        }
+        else if (options.encoding == paint_frame_encoding::delta)
+        {
+            MemoryStream ms;
+            write_session_deltas<uint16_t>(ms, sessions.data(), count);
+            data.assign((const uint8_t*)ms.GetData(), (const uint8_t*)ms.GetData() + ms.GetLength());
+        }
+        else
+        {
+            MemoryStream ms(count * session_record_size<uint16_t>);
+            for (const paint_session* session : sessions)
+            {
+                write_session<uint16_t>(ms, *session);
+            }
+            data.assign((const uint8_t*)ms.GetData(), (const uint8_t*)ms.GetData() + ms.GetLength());
+        }
+        uLongf size = compressBound((uLong)data.size());
+        compressed[f].resize(size);
+        compress2(compressed[f].data(), &size, data.data(), (uLong)data.size(), Z_BEST_COMPRESSION);
+        compressed[f].resize(size);
+        frames[f].compressed_size = (uint32_t)size;
+        frames[f].uncompressed_size = (uint32_t)data.size();
+    });
+    std::vector<uint8_t> rotations;
+    for (const auto& session : corpus.sessions)
+    {
+        rotations.push_back(session.CurrentRotation);
+    }
+    uint64_t offset = sizeof(header) + park.size() + frames.size() * sizeof(psa_v3_frame);
+    header.rotation_offset = offset;
+    offset += rotations.size();
+    for (auto& frame : frames)
+    {
+        frame.offset = offset;
+        offset += frame.compressed_size;
+    }
+
+    FILE* file = fopen(fname, "wb");
+    if (file == nullptr)
+    {
+        std::cout << "Could not write " << fname << std::endl;
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && fwrite(park.data(), 1, park.size(), file) == park.size();
+    ok = ok && fwrite(frames.data(), sizeof(psa_v3_frame), frames.size(), file) == frames.size();
+    ok = ok && fwrite(rotations.data(), 1, rotations.size(), file) == rotations.size();
+    for (const auto& frame : compressed)
+    {
+        ok = ok && fwrite(frame.data(), 1, frame.size(), file) == frame.size();
+    }
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+    {
+        std::cout << "Could not write " << fname << std::endl;
+        return false;
+    }
+    std::cout << "Wrote " << header.session_count << " sessions in " << header.frame_count << " frames to " << fname << " ("
+              << offset << " bytes)" << std::endl;
+    return true;
+}
+
+void paint_sessions_write_records(IStream& ms, const paint_session* sessions, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        write_session<uint8_t>(ms, sessions[i]);
+    }
+}
+
+void paint_sessions_read_records(IStream& ms, paint_session* sessions, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        read_session<uint8_t>(ms, sessions[i]);
+    }
+}
+
+paint_session_set::paint_session_set(std::vector<paint_session> sessions, std::vector<uint32_t> order)
+    : _storage(std::move(sessions))
+    , _order(std::move(order))
+    , _data(_storage.data())
+    , _size(_order.empty() ? _storage.size() : _order.size())
+{
+}
+
+paint_session_set::paint_session_set(std::shared_ptr<const MappedFile> image, size_t count)
+    : _image(std::move(image))
+    , _data((paint_session*)_image->GetData())
+    , _size(count)
+{
+}
+
+paint_corpus_ptr paint_corpus_create(std::string name, std::string park, std::vector<paint_session> sessions)
+{
+    auto corpus = std::make_shared<paint_corpus>();
+    corpus->name = std::move(name);
+    corpus->park = std::move(park);
+    corpus->sessions = paint_session_set(std::move(sessions));
+    return corpus;
+}
+
+paint_corpus_ptr paint_corpus_load(const char* fname, const paint_corpus_load_options& options)
+{
+    static std::ostream quiet(nullptr);
+    std::ostream& log = options.verbose ? std::cout : quiet;
+    auto start = load_clock::now();
+    MappedFile file(fname);
+    if (!file.IsOpen())
+    {
+        log << "Could not read " << fname << std::endl;
+        return nullptr;
+    }
+    if (is_v2(file))
+    {
+        return validate_corpus(load_v2(fname, file, start, options, log), log);
+    }
+    if (is_v3(file))
+    {
+        return validate_corpus(load_v3(fname, file, start, options, log), log);
+    }
+    std::string park;
+    std::vector<paint_session> sessions = extract_paint_session(fname, file, park, log);
+    if (sessions.empty())
+    {
+        return nullptr;
+    }
+    log << "Loaded " << fname << " in " << milliseconds_since(start) << " ms" << std::endl;
+    return validate_corpus(make_corpus(fname, std::move(park), std::move(sessions), options.deduplicate, log), log);
+}
+
+bool paint_corpus_probe(const char* fname, paint_capture_info& info)
+{
+    static std::ostream quiet(nullptr);
+    MappedFile file(fname);
+    if (!file.IsOpen())
+    {
+        return false;
+    }
+    if (is_v2(file))
+    {
+        psa_v2_header header;
+        if (!read_v2_header(fname, file, header, info.park, quiet))
+        {
+            return false;
+        }
+        info.version = 2;
+        info.session_count = header.session_count;
+        return info.session_count != 0;
+    }
+    if (is_v3(file))
+    {
+        psa_v3_header header;
+        const psa_v3_frame* frames;
+        if (!read_v3_header(fname, file, header, info.park, frames, quiet))
+        {
+            return false;
+        }
+        info.version = 3;
+        info.session_count = header.session_count;
+        return info.session_count != 0;
+    }
+    if (file.GetSize() < 4)
+    {
+        return false;
+    }
+    try
+    {
+        // Everything the header needs sits in the first inflated chunk
+        uint32_t cb;
+        std::memcpy(&cb, file.GetData(), sizeof(cb));
+        InflateStream ms(file.GetData() + 4, file.GetSize() - 4, cb);
+        if (ms.ReadStdString() != "paint session v1")
+        {
+            return false;
+        }
+        info.version = 1;
+        info.park = ms.ReadStdString();
+        info.session_count = ms.ReadValue<uint32_t>();
+    }
+    catch (const IOException&)
+    {
+        return false;
+    }
+    return info.session_count != 0;
+}
+
+paint_corpus_source::paint_corpus_source(
+    std::string fname, paint_capture_info info, std::function<void(const paint_corpus&)> on_load)
+    : _fname(std::move(fname))
+    , _info(std::move(info))
+    , _on_load(std::move(on_load))
+{
+}
+
+paint_corpus_source::paint_corpus_source(paint_corpus_ptr corpus)
+    : _fname(corpus->name)
+    , _corpus(std::move(corpus))
+    , _loaded(true)
+{
+    _info.session_count = (uint32_t)_corpus->sessions.size();
+    _info.park = _corpus->park;
+}
+
+paint_corpus_ptr paint_corpus_source::get()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_loaded)
+    {
+        // A capture that fails to load is not tried again by every benchmark using it
+        _loaded = true;
+        _corpus = paint_corpus_load(_fname.c_str());
+        if (_corpus != nullptr && _on_load)
+        {
+            _on_load(*_corpus);
+        }
+    }
+    return _corpus;
+}
+
+std::unique_ptr<paint_session> paint_corpus_load_session(const char* fname, size_t index)
+{
+    static std::ostream quiet(nullptr);
+    MappedFile file(fname);
+    if (!file.IsOpen())
+    {
+        return nullptr;
+    }
+    auto session = std::make_unique<paint_session>();
+    std::string park;
+    try
+    {
+        if (is_v2(file))
+        {
+            psa_v2_header header;
+            if (!read_v2_header(fname, file, header, park, quiet) || index >= header.session_count)
+            {
+                return nullptr;
+            }
+            const uint8_t* image = file.GetData() + header.session_offset + index * header.session_stride;
+            if (!decode_v2_session(header, image, *session))
+            {
+                return nullptr;
+            }
+        }
+        else if (is_v3(file))
+        {
+            // Only the frame holding the session is inflated, and only up to the session itself
+            psa_v3_header header;
+            const psa_v3_frame* frames;
+            if (!read_v3_header(fname, file, header, park, frames, quiet) || index >= header.session_count)
+            {
+                return nullptr;
+            }
+            read_v3_frame(file, header, frames, (uint32_t)(index / header.frame_sessions),
+                (uint32_t)(index % header.frame_sessions), 1, session.get());
+        }
+        else
+        {
+            // A v1 capture is one stream, everything before the session has to be inflated
+            uint32_t cb;
+            std::memcpy(&cb, file.GetData(), sizeof(cb));
+            InflateStream ms(file.GetData() + 4, file.GetSize() - 4, cb);
+            if (ms.ReadStdString() != "paint session v1")
+            {
+                return nullptr;
+            }
+            ms.ReadStdString();
+            if (index >= ms.ReadValue<uint32_t>())
+            {
+                return nullptr;
+            }
+            ms.Seek(index * paint_session_record_size, ISTREAM_SEEK_CURRENT);
+            read_session<uint8_t>(ms, *session);
+        }
+    }
+    catch (const IOException&)
+    {
+        return nullptr;
+    }
+    return validate_session_links(*session) ? std::move(session) : nullptr;
+}
+
+paint_session_set paint_corpus_checkout(const paint_corpus& corpus)
+{
+#ifdef PSA_COMPRESSED_POINTERS
+    if (corpus.sessions.is_mapped())
+    {
+        auto image = std::make_shared<MappedFile>(corpus.name.c_str(), corpus.image_offset, PAINT_SESSION_ALIGNMENT, true);
+        if (image->IsOpen())
+        {
+            return paint_session_set(std::move(image), corpus.sessions.size());
+        }
+    }
+#endif
+    std::vector<paint_session> sessions(corpus.sessions.begin(), corpus.sessions.end());
+    for (size_t i = 0; i < std::size(sessions); i++)
+    {
+        rebase_session(corpus.sessions[i], sessions[i]);
+    }
+    return paint_session_set(std::move(sessions));
+}
+
+// One quarter turn of the world about the map: (x, y) becomes (extent - y, x), so what was at the back for camera
+// rotation r is at the back for r + 1. Extents stay ordered the way they were, inverted ones included.
+static void rotate_bounds(paint_struct_bound_box& bounds)
+{
+    constexpr uint16_t map_extent = 0x2000;
+    uint16_t x = bounds.x;
+    uint16_t x_end = bounds.x_end;
+    bounds.x = (uint16_t)(map_extent - bounds.y_end);
+    bounds.x_end = (uint16_t)(map_extent - bounds.y);
+    bounds.y = x;
+    bounds.y_end = x_end;
+}
+
+// The quadrant the game's PaintSessionAddPsToQuadrant files a struct under when seen from `rotation`
+static uint32_t rotated_quadrant(const paint_struct_bound_box& bounds, uint8_t rotation)
+{
+    int32_t x = (int16_t)bounds.x;
+    int32_t y = (int16_t)bounds.y;
+    static const int32_t hashes[][3] = { { 1, 1, 0 }, { -1, 1, 0x2000 }, { -1, -1, 0x4000 }, { 1, -1, 0x2000 } };
+    const int32_t* hash = hashes[rotation];
+    return (uint32_t)std::clamp((hash[0] * x + hash[1] * y + hash[2]) / 32, 0, (int32_t)session_quadrant_count - 1);
+}
+
+void paint_session_rotate(const paint_session& session, uint8_t rotation, paint_session& out)
+{
+    out = session;
+    rebase_session(session, out);
+    uint8_t turns = (rotation - session.CurrentRotation) & 3;
+    out.CurrentRotation = rotation & 3;
+
+    // Structs are prepended in pool order again, which is the order the game generated them in
+    std::vector<uint16_t> slots;
+    for (const auto& quadrant : session.Quadrants)
+    {
+        for (const paint_struct* ps = quadrant; ps != nullptr; ps = ps->next_quadrant_ps)
+        {
+            slots.push_back((uint16_t)((const paint_entry*)ps - session.PaintStructs));
+        }
+    }
+    std::sort(slots.begin(), slots.end());
+    for (auto& quadrant : out.Quadrants)
+    {
+        quadrant = nullptr;
+    }
+    out.QuadrantBackIndex = UINT32_MAX;
+    out.QuadrantFrontIndex = 0;
+    for (uint16_t slot : slots)
+    {
+        paint_struct* ps = &out.PaintStructs[slot].basic;
+        for (paint_struct* child = ps; child != nullptr; child = child->children)
+        {
+            for (uint8_t turn = 0; turn < turns; turn++)
+            {
+                rotate_bounds(child->bounds);
+            }
+        }
+        uint32_t quadrant = rotated_quadrant(ps->bounds, out.CurrentRotation);
+        ps->quadrant_index = (uint16_t)quadrant;
+        ps->next_quadrant_ps = out.Quadrants[quadrant];
+        out.Quadrants[quadrant] = ps;
+        out.QuadrantBackIndex = std::min(out.QuadrantBackIndex, quadrant);
+        out.QuadrantFrontIndex = std::max(out.QuadrantFrontIndex, quadrant);
+    }
+}
+
+paint_corpus_ptr paint_corpus_rotate(const paint_corpus& corpus, uint8_t rotation)
+{
+    std::vector<paint_session> sessions(corpus.sessions.size());
+    for (size_t i = 0; i < std::size(sessions); i++)
+    {
+        paint_session_rotate(corpus.sessions[i], rotation, sessions[i]);
+    }
+    return paint_corpus_create(corpus.name + " rotation " + std::to_string(rotation & 3), corpus.park, std::move(sessions));
+}
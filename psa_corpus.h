@@ -0,0 +1,292 @@
+#pragma once
+#include "structs.h"
+
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class MappedFile;
+struct IStream;
+
+// Serialised size of one session in v1 records: 4000 structs, 512 quadrants, the head struct and both quadrant indices
+constexpr uint64_t paint_session_record_size = 4000 * 26 + 512 * 4 + 26 + 2 * 4;
+
+/**
+ * Sessions backed either by heap storage or by a mapped v2 image, which is used in place.
+ * Heap storage may hold byte-identical sessions once, `order` then maps each session to its stored copy.
+ * Move-only: a copy of heap storage would leave native links pointing into the original.
+ */
+class paint_session_set
+{
+private:
+    std::vector<paint_session> _storage;
+    std::vector<uint32_t> _order;
+    std::shared_ptr<const MappedFile> _image;
+    paint_session* _data = nullptr;
+    size_t _size = 0;
+
+public:
+    template<typename Session> class iterator_base
+    {
+    private:
+        Session* _data;
+        const uint32_t* _order;
+        size_t _index;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = paint_session;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Session*;
+        using reference = Session&;
+
+        iterator_base(Session* data, const uint32_t* order, size_t index)
+            : _data(data)
+            , _order(order)
+            , _index(index)
+        {
+        }
+        reference operator*() const
+        {
+            return _data[_order != nullptr ? _order[_index] : _index];
+        }
+        pointer operator->() const
+        {
+            return &**this;
+        }
+        iterator_base& operator++()
+        {
+            _index++;
+            return *this;
+        }
+        iterator_base operator++(int)
+        {
+            iterator_base previous = *this;
+            _index++;
+            return previous;
+        }
+        bool operator==(const iterator_base& other) const
+        {
+            return _index == other._index;
+        }
+        bool operator!=(const iterator_base& other) const
+        {
+            return _index != other._index;
+        }
+    };
+    using iterator = iterator_base<paint_session>;
+    using const_iterator = iterator_base<const paint_session>;
+
+    paint_session_set() = default;
+    explicit paint_session_set(std::vector<paint_session> sessions, std::vector<uint32_t> order = {});
+    paint_session_set(std::shared_ptr<const MappedFile> image, size_t count);
+    paint_session_set(paint_session_set&&) = default;
+    paint_session_set& operator=(paint_session_set&&) = default;
+
+    bool is_mapped() const
+    {
+        return _image != nullptr;
+    }
+    size_t size() const
+    {
+        return _size;
+    }
+    // Sessions actually stored, less than size() when duplicates share storage
+    size_t unique_size() const
+    {
+        return _order.empty() ? _size : _storage.size();
+    }
+    bool empty() const
+    {
+        return _size == 0;
+    }
+    iterator begin()
+    {
+        return iterator(_data, _order.empty() ? nullptr : _order.data(), 0);
+    }
+    iterator end()
+    {
+        return iterator(_data, nullptr, _size);
+    }
+    const_iterator begin() const
+    {
+        return const_iterator(_data, _order.empty() ? nullptr : _order.data(), 0);
+    }
+    const_iterator end() const
+    {
+        return const_iterator(_data, nullptr, _size);
+    }
+    paint_session& operator[](size_t i)
+    {
+        return _data[_order.empty() ? i : _order[i]];
+    }
+    const paint_session& operator[](size_t i) const
+    {
+        return _data[_order.empty() ? i : _order[i]];
+    }
+};
+
+/**
+ * Paint sessions loaded from one capture, with all links already resolved.
+ * A corpus is immutable once created and is shared by every benchmark and verify() that uses it.
+ * Consumers that arrange sessions work on their own copy obtained from paint_corpus_checkout().
+ */
+struct paint_corpus
+{
+    std::string name;
+    std::string park;
+    paint_session_set sessions;
+    // File offset of the session image when `sessions` is a mapped v2 file
+    uint64_t image_offset = 0;
+    // Time spent checking that no paint struct list is cyclic or shares structs with another
+    double link_validation_ms = 0;
+};
+
+using paint_corpus_ptr = std::shared_ptr<const paint_corpus>;
+
+struct paint_corpus_load_options
+{
+    // Threads inflating the frames of a v3 capture, 0 for one per core
+    unsigned threads = 0;
+    // Report the capture and load time on stdout
+    bool verbose = true;
+    // Store byte-identical sessions once, see paint_session_set
+    bool deduplicate = true;
+};
+
+/**
+ * Loads all sessions of a .psa capture, v1, v2 or v3, and validates their links. Returns nullptr if the file is invalid.
+ */
+paint_corpus_ptr paint_corpus_load(const char* fname, const paint_corpus_load_options& options = {});
+
+/**
+ * What a capture holds, as far as its header tells without decoding any session.
+ */
+struct paint_capture_info
+{
+    // 1, 2 or 3
+    uint32_t version = 0;
+    uint32_t session_count = 0;
+    std::string park;
+};
+
+/**
+ * Reads the header of a .psa capture. v1 captures only inflate their first few bytes. Returns false if the file
+ * is not a capture, the sessions themselves are only checked once loaded.
+ */
+bool paint_corpus_probe(const char* fname, paint_capture_info& info);
+
+/**
+ * A capture that is loaded the first time it is needed and then kept for everyone sharing the source.
+ * `on_load` runs once, right after the load, with the fresh corpus.
+ */
+class paint_corpus_source
+{
+private:
+    std::string _fname;
+    paint_capture_info _info;
+    std::function<void(const paint_corpus&)> _on_load;
+    std::mutex _mutex;
+    paint_corpus_ptr _corpus;
+    bool _loaded = false;
+
+public:
+    paint_corpus_source(std::string fname, paint_capture_info info, std::function<void(const paint_corpus&)> on_load = {});
+    // Wraps a corpus that already exists
+    explicit paint_corpus_source(paint_corpus_ptr corpus);
+
+    const std::string& name() const
+    {
+        return _fname;
+    }
+    const paint_capture_info& info() const
+    {
+        return _info;
+    }
+    // Returns nullptr if the capture turned out to be invalid
+    paint_corpus_ptr get();
+};
+
+using paint_corpus_source_ptr = std::shared_ptr<paint_corpus_source>;
+
+/**
+ * Loads a single session of a capture. v3 captures only inflate the frame that holds it, v1 captures have to
+ * inflate everything up to it. Returns nullptr if the file is invalid or has no such session.
+ */
+std::unique_ptr<paint_session> paint_corpus_load_session(const char* fname, size_t index);
+
+/**
+ * Writes sessions as v1 records, the body of v1 captures and of v3 records frames.
+ */
+void paint_sessions_write_records(IStream& ms, const paint_session* sessions, size_t count);
+
+/**
+ * Decodes v1 records into value-initialised sessions and resolves their links in the same pass.
+ * Throws IOException on short data or a link outside its session.
+ */
+void paint_sessions_read_records(IStream& ms, paint_session* sessions, size_t count);
+
+/**
+ * Wraps sessions whose links already point into `sessions` themselves.
+ */
+paint_corpus_ptr paint_corpus_create(std::string name, std::string park, std::vector<paint_session> sessions);
+
+/**
+ * Counts the sessions whose recorded content differs between the two corpora, position by position. Sessions only
+ * one of them has count as differing.
+ */
+size_t paint_corpus_differing_sessions(const paint_corpus& a, const paint_corpus& b);
+
+/**
+ * Returns a mutable copy of the corpus sessions with links pointing into the copy.
+ * Mapped corpora get a private copy-on-write mapping, so only the pages arrange touches are ever copied.
+ */
+paint_session_set paint_corpus_checkout(const paint_corpus& corpus);
+
+/**
+ * Copies a session as the game would have generated it for camera rotation `rotation`: the world is turned about
+ * the map by quarter turns, so the bounds of every listed struct and its children are remapped, each struct goes
+ * to the quadrant the game files it under for that rotation, and the lists are rebuilt in pool order.
+ * Screen positions are kept. check_bounding_box treats touching boxes differently in every rotation, so the
+ * arranged order may differ from the original rotation's where boxes touch.
+ */
+void paint_session_rotate(const paint_session& session, uint8_t rotation, paint_session& out);
+
+/**
+ * Every session of the corpus turned to `rotation`, see paint_session_rotate().
+ */
+paint_corpus_ptr paint_corpus_rotate(const paint_corpus& corpus, uint8_t rotation);
+
+/**
+ * Writes the corpus as a v2 capture: uncompressed session images that compressed-link builds map and arrange
+ * without decoding. Only builds with compressed links can write it, as the image is their in-memory layout.
+ */
+bool paint_corpus_write_v2(const paint_corpus& corpus, const char* fname);
+
+enum class paint_frame_encoding : uint32_t
+{
+    // v1 session records back to back
+    records = 0,
+    // Delta coded field columns, see psa_columnar.h
+    columnar = 1,
+    // A keyframe record per frame, then only what changed from one session to the next
+    delta = 2,
+};
+
+struct paint_capture_options
+{
+    // Sessions per independently deflated frame
+    uint32_t frame_sessions = 8;
+    paint_frame_encoding encoding = paint_frame_encoding::columnar;
+    // Threads deflating frames, 0 for one per core
+    unsigned threads = 0;
+};
+
+/**
+ * Writes the corpus as a v3 capture: a frame table followed by frames of consecutive sessions that are deflated
+ * separately, so they can be inflated in parallel or on their own.
+ */
+bool paint_corpus_write_v3(const paint_corpus& corpus, const char* fname, const paint_capture_options& options = {});
@@ -0,0 +1,70 @@
+#include "psa_frame.h"
+
+#include <algorithm>
+#include <cstdint>
+
+void paint_frame_record(const paint_session& session, paint_frame_input& input)
+{
+    input.slots.clear();
+    input.structs.clear();
+    if (session.QuadrantBackIndex == UINT32_MAX)
+    {
+        return;
+    }
+    for (uint32_t quadrant = session.QuadrantBackIndex; quadrant <= session.QuadrantFrontIndex; quadrant++)
+    {
+        for (const paint_struct* ps = session.Quadrants[quadrant]; ps != nullptr; ps = ps->next_quadrant_ps)
+        {
+            input.slots.push_back((uint16_t)((const paint_entry*)ps - session.PaintStructs));
+        }
+    }
+    std::sort(input.slots.begin(), input.slots.end());
+    for (uint16_t slot : input.slots)
+    {
+        input.structs.push_back(session.PaintStructs[slot].basic);
+    }
+}
+
+void paint_frame_generate(paint_session& session, const paint_frame_input& input)
+{
+    for (auto& quadrant : session.Quadrants)
+    {
+        quadrant = nullptr;
+    }
+    uint32_t back = UINT32_MAX;
+    uint32_t front = 0;
+    for (size_t i = 0; i < input.slots.size(); i++)
+    {
+        paint_struct* ps = &session.PaintStructs[input.slots[i]].basic;
+        *ps = input.structs[i];
+        uint32_t quadrant = ps->quadrant_index;
+        ps->next_quadrant_ps = session.Quadrants[quadrant];
+        session.Quadrants[quadrant] = ps;
+        back = std::min(back, quadrant);
+        front = std::max(front, quadrant);
+    }
+    session.QuadrantBackIndex = back;
+    session.QuadrantFrontIndex = front;
+}
+
+static uint32_t draw_image(uint32_t image_id, uint32_t colour_image_id, uint16_t x, uint16_t y)
+{
+    return image_id ^ (colour_image_id * 31) ^ ((uint32_t)x << 16 | y);
+}
+
+uint32_t paint_frame_draw(const paint_session& session)
+{
+    uint32_t checksum = 0;
+    for (const paint_struct* ps = session.PaintHead.next_quadrant_ps; ps != nullptr; ps = ps->next_quadrant_ps)
+    {
+        for (const paint_struct* child = ps; child != nullptr; child = child->children)
+        {
+            checksum = checksum * 33 + draw_image(child->image_id, child->colour_image_id, child->x, child->y);
+            for (const attached_paint_struct* attached = child->attached_ps; attached != nullptr; attached = attached->next)
+            {
+                checksum = checksum * 33 + draw_image(attached->image_id, attached->colour_image_id, attached->x, attached->y);
+            }
+        }
+    }
+    return checksum;
+}
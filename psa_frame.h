@@ -0,0 +1,35 @@
+#pragma once
+#include "structs.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Stand-ins for the frame stages around arrange, so a layout change can be judged on what a whole frame costs.
+ * Generation is replayed from a recording of the session, drawing walks the arranged list without blitting.
+ */
+
+/**
+ * The structs generation put on a session's quadrant lists, in pool order, as they were before arrange.
+ * Links inside `structs` stay valid only for the session they were recorded from.
+ */
+struct paint_frame_input
+{
+    std::vector<uint16_t> slots;
+    std::vector<paint_struct> structs;
+};
+
+void paint_frame_record(const paint_session& session, paint_frame_input& input);
+
+/**
+ * Replays generation into the session it was recorded from: clears every quadrant, then writes each struct into
+ * its slot and prepends it to its quadrant like the game's PaintSessionAddPsToQuadrant, which rebuilds the
+ * recorded lists exactly.
+ */
+void paint_frame_generate(paint_session& session, const paint_frame_input& input);
+
+/**
+ * Walks an arranged session the way the game draws it: every struct of the list, then its children, each followed
+ * by its attached_ps chain, reading what a blit would read. Returns a checksum of it all.
+ */
+uint32_t paint_frame_draw(const paint_session& session);
@@ -0,0 +1,48 @@
+#include "psa_journal.h"
+
+void paint_session_journal::record(const paint_session* sessions, size_t count)
+{
+    _sessions.clear();
+    _entries.clear();
+    for (size_t i = 0; i < count; i++)
+    {
+        const paint_session& session = sessions[i];
+        const paint_struct* base = &session.PaintStructs[0].basic;
+        session_record record;
+        record.head_next_quadrant_ps = session.PaintHead.next_quadrant_ps;
+        record.head_quadrant_flags = session.PaintHead.quadrant_flags;
+        record.first_entry = _entries.size();
+        if (session.QuadrantBackIndex != UINT32_MAX)
+        {
+            for (uint32_t quadrant = session.QuadrantBackIndex; quadrant <= session.QuadrantFrontIndex; quadrant++)
+            {
+                for (const paint_struct* ps = session.Quadrants[quadrant]; ps != nullptr; ps = ps->next_quadrant_ps)
+                {
+                    // paint_entry is a union, so the stride between structs is sizeof(paint_entry)
+                    size_t index = ((const paint_entry*)ps) - ((const paint_entry*)base);
+                    _entries.push_back({ ps->next_quadrant_ps, (uint16_t)index, ps->quadrant_flags });
+                }
+            }
+        }
+        record.entry_count = _entries.size() - record.first_entry;
+        _sessions.push_back(record);
+    }
+}
+
+void paint_session_journal::restore(paint_session* sessions) const
+{
+    for (size_t i = 0; i < _sessions.size(); i++)
+    {
+        paint_session& session = sessions[i];
+        const session_record& record = _sessions[i];
+        session.PaintHead.next_quadrant_ps = record.head_next_quadrant_ps;
+        session.PaintHead.quadrant_flags = record.head_quadrant_flags;
+        const entry* entries = _entries.data() + record.first_entry;
+        for (size_t j = 0; j < record.entry_count; j++)
+        {
+            paint_struct& ps = session.PaintStructs[entries[j].index].basic;
+            ps.next_quadrant_ps = entries[j].next_quadrant_ps;
+            ps.quadrant_flags = entries[j].quadrant_flags;
+        }
+    }
+}
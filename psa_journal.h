@@ -0,0 +1,48 @@
+#pragma once
+#include "structs.h"
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Records the part of a session that paint_session_arrange() mutates: PaintHead and the
+ * next_quadrant_ps link and quadrant_flags of every struct reachable from Quadrants[QuadrantBackIndex..QuadrantFrontIndex].
+ * Restoring writes back only those fields, so its cost is proportional to the structs arrange can touch
+ * instead of the size of a whole paint_session.
+ *
+ * Restore into the same sessions that were recorded (or bit-exact copies at the same addresses),
+ * as the recorded links are not rebased.
+ */
+class paint_session_journal
+{
+public:
+    void record(const paint_session* sessions, size_t count);
+    void restore(paint_session* sessions) const;
+
+    size_t session_count() const
+    {
+        return _sessions.size();
+    }
+    size_t entry_count() const
+    {
+        return _entries.size();
+    }
+
+private:
+    struct entry
+    {
+        paint_ptr<paint_struct> next_quadrant_ps;
+        uint16_t index;
+        uint8_t quadrant_flags;
+    };
+    struct session_record
+    {
+        paint_ptr<paint_struct> head_next_quadrant_ps;
+        uint8_t head_quadrant_flags;
+        size_t first_entry;
+        size_t entry_count;
+    };
+
+    std::vector<session_record> _sessions;
+    std::vector<entry> _entries;
+};
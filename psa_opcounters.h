@@ -0,0 +1,62 @@
+#pragma once
+#include "structs.h"
+
+#include <cstdint>
+
+#ifdef WITH_OPCOUNTERS
+#define PSA_OPCOUNTERS
+#endif
+
+/**
+ * Work done by paint_arrange_structs_helper_rotation() in either engine, per quadrant it was called for.
+ * Only builds with PSA_OPCOUNTERS count anything, everywhere else PSA_COUNT_OP() compiles to nothing.
+ */
+struct paint_arrange_op_counts
+{
+    // Links followed, in every walk: skipping to the quadrant, stamping flags, scanning and comparing
+    uint64_t walk_steps = 0;
+    uint64_t bbox_checks = 0;
+    // check_bounding_box() calls that returned true, each moves one struct in front of the one being placed
+    uint64_t bbox_true = 0;
+    // Flag stamping walks, one per helper call that reaches its quadrant
+    uint64_t flag_passes = 0;
+
+    paint_arrange_op_counts& operator+=(const paint_arrange_op_counts& other)
+    {
+        walk_steps += other.walk_steps;
+        bbox_checks += other.bbox_checks;
+        bbox_true += other.bbox_true;
+        flag_passes += other.flag_passes;
+        return *this;
+    }
+};
+
+#ifdef PSA_OPCOUNTERS
+/**
+ * Counts of the calling thread since the last clear(), arrange only ever adds to them.
+ */
+struct paint_arrange_op_trace
+{
+    paint_arrange_op_counts quadrants[MAX_PAINT_QUADRANTS];
+
+    void clear()
+    {
+        *this = {};
+    }
+    paint_arrange_op_counts total() const
+    {
+        paint_arrange_op_counts sum;
+        for (const auto& quadrant : quadrants)
+        {
+            sum += quadrant;
+        }
+        return sum;
+    }
+};
+
+extern thread_local paint_arrange_op_trace paint_arrange_ops;
+
+#define PSA_COUNT_OP(quadrant, counter) (paint_arrange_ops.quadrants[(quadrant) % MAX_PAINT_QUADRANTS].counter++)
+#else
+#define PSA_COUNT_OP(quadrant, counter) ((void)0)
+#endif
@@ -1,5 +1,6 @@
 #include "structs.h"
 #include "psa_openrct2.h"
+#include "psa_opcounters.h"
 
 template<uint8_t>
 static bool check_bounding_box(const paint_struct_bound_box& initialBBox, const paint_struct_bound_box& currentBBox)
@@ -78,6 +79,7 @@ static paint_struct* paint_arrange_structs_helper_rotation(paint_struct* ps_next
     {
         ps = ps_next;
         ps_next = ps_next->next_quadrant_ps;
+        PSA_COUNT_OP(quadrantIndex, walk_steps);
         if (ps_next == nullptr)
             return ps;
     } while (quadrantIndex > ps_next->quadrant_index);
@@ -85,10 +87,12 @@ static paint_struct* paint_arrange_structs_helper_rotation(paint_struct* ps_next
     // Cache the last visited node so we don't have to walk the whole list again
     paint_struct* ps_cache = ps;
 
+    PSA_COUNT_OP(quadrantIndex, flag_passes);
     ps_temp = ps;
     do
     {
         ps = ps->next_quadrant_ps;
+        PSA_COUNT_OP(quadrantIndex, walk_steps);
         if (ps == nullptr)
             break;
 
@@ -112,6 +116,7 @@ static paint_struct* paint_arrange_structs_helper_rotation(paint_struct* ps_next
         while (true)
         {
             ps_next = ps->next_quadrant_ps;
+            PSA_COUNT_OP(quadrantIndex, walk_steps);
             if (ps_next == nullptr)
                 return ps_cache;
             if (ps_next->quadrant_flags & PAINT_QUADRANT_FLAG_BIGGER)
@@ -130,6 +135,7 @@ static paint_struct* paint_arrange_structs_helper_rotation(paint_struct* ps_next
         {
             ps = ps_next;
             ps_next = ps_next->next_quadrant_ps;
+            PSA_COUNT_OP(quadrantIndex, walk_steps);
             if (ps_next == nullptr)
                 break;
             if (ps_next->quadrant_flags & PAINT_QUADRANT_FLAG_BIGGER)
@@ -140,9 +146,11 @@ static paint_struct* paint_arrange_structs_helper_rotation(paint_struct* ps_next
             const paint_struct_bound_box& currentBBox = ps_next->bounds;
 
             const bool compareResult = check_bounding_box<_TRotation>(initialBBox, currentBBox);
+            PSA_COUNT_OP(quadrantIndex, bbox_checks);
 
             if (compareResult)
             {
+                PSA_COUNT_OP(quadrantIndex, bbox_true);
                 ps->next_quadrant_ps = ps_next->next_quadrant_ps;
                 paint_struct* ps_temp2 = ps_temp->next_quadrant_ps;
                 ps_temp->next_quadrant_ps = ps_next;
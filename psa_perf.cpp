@@ -0,0 +1,201 @@
+#include "psa_perf.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#ifdef __linux
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/prctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+
+    #include <cerrno>
+    #include <cstdint>
+    #include <cstring>
+
+static constexpr uint64_t cache_read_miss(uint64_t cache)
+{
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+static const struct
+{
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+} perf_events[] = {
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "l1d_misses", PERF_TYPE_HW_CACHE, cache_read_miss(PERF_COUNT_HW_CACHE_L1D) },
+    { "llc_misses", PERF_TYPE_HW_CACHE, cache_read_miss(PERF_COUNT_HW_CACHE_LL) },
+    { "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "dtlb_misses", PERF_TYPE_HW_CACHE, cache_read_miss(PERF_COUNT_HW_CACHE_DTLB) },
+};
+
+paint_perf_counters::paint_perf_counters()
+{
+    for (const auto& definition : perf_events)
+    {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = definition.type;
+        attr.config = definition.config;
+        // Enabled and disabled together by prctl(), only user space work of this thread counts
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd < 0)
+        {
+            if (_error.empty())
+            {
+                _error = std::string(definition.name) + ": " + std::strerror(errno);
+            }
+            continue;
+        }
+        _events.push_back({ definition.name, fd });
+    }
+}
+
+paint_perf_counters::~paint_perf_counters()
+{
+    for (const auto& event : _events)
+    {
+        close(event.fd);
+    }
+}
+
+// One syscall switches every counter of the thread, instead of an ioctl per counter
+void paint_perf_counters::start()
+{
+    if (available())
+    {
+        prctl(PR_TASK_PERF_EVENTS_ENABLE);
+    }
+}
+
+void paint_perf_counters::stop()
+{
+    if (available())
+    {
+        prctl(PR_TASK_PERF_EVENTS_DISABLE);
+    }
+}
+
+std::vector<std::pair<const char*, double>> paint_perf_counters::read() const
+{
+    std::vector<std::pair<const char*, double>> counts;
+    for (const auto& event : _events)
+    {
+        uint64_t values[3]{};
+        if (::read(event.fd, values, sizeof(values)) != (ssize_t)sizeof(values) || values[2] == 0)
+        {
+            continue;
+        }
+        counts.emplace_back(event.name, (double)values[0] * values[1] / values[2]);
+    }
+    return counts;
+}
+#else
+paint_perf_counters::paint_perf_counters()
+    : _error("not supported on this platform")
+{
+}
+
+paint_perf_counters::~paint_perf_counters() = default;
+
+void paint_perf_counters::start()
+{
+}
+
+void paint_perf_counters::stop()
+{
+}
+
+std::vector<std::pair<const char*, double>> paint_perf_counters::read() const
+{
+    return {};
+}
+#endif
+
+double paint_tick_ns()
+{
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+    static const double tick_ns = [] {
+        // Long enough that reading either clock is noise, short enough not to show at startup
+        using clock = std::chrono::steady_clock;
+        auto begin = clock::now();
+        uint64_t begin_ticks = paint_ticks_begin();
+        auto end = begin;
+        while (end - begin < std::chrono::milliseconds(20))
+        {
+            end = clock::now();
+        }
+        uint64_t end_ticks = paint_ticks_end();
+        return std::chrono::duration<double, std::nano>(end - begin).count() / (double)(end_ticks - begin_ticks);
+    }();
+    return tick_ns;
+#else
+    return 1.0;
+#endif
+}
+
+uint64_t paint_ticks_overhead()
+{
+    // The least of many tries: anything above it is an interrupt or a cold cache, not the clock
+    static const uint64_t overhead = [] {
+        uint64_t least = UINT64_MAX;
+        for (int i = 0; i < 10000; i++)
+        {
+            uint64_t begin = paint_ticks_begin();
+            uint64_t end = paint_ticks_end();
+            least = std::min(least, end - begin);
+        }
+        return least;
+    }();
+    return overhead;
+}
+
+void paint_cache_flush(const void* data, size_t size)
+{
+    // clflush and mfence are SSE2, which 32-bit builds only have with -msse2 (GCC, Clang) or /arch:SSE2 (MSVC)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    if (size == 0)
+    {
+        return;
+    }
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t offset = 0; offset < size; offset += 64)
+    {
+        _mm_clflush(bytes + offset);
+    }
+    _mm_clflush(bytes + size - 1);
+    _mm_mfence();
+#else
+    paint_cache_evict();
+#endif
+}
+
+void paint_cache_evict()
+{
+    static std::vector<uint8_t> buffer = [] {
+        size_t l2 = 0;
+#ifdef __linux
+        long size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        l2 = size > 0 ? (size_t)size : 0;
+#endif
+        return std::vector<uint8_t>(4 * std::max<size_t>(l2, 2 * 1024 * 1024));
+    }();
+    static volatile uint8_t sink;
+    uint8_t sum = 0;
+    for (size_t offset = 0; offset < buffer.size(); offset += 64)
+    {
+        sum += buffer[offset];
+        buffer[offset] = sum;
+    }
+    // Read back as well, so the sink is consumed and not just set
+    sink = (uint8_t)(sink ^ sum);
+}
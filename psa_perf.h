@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__i386__) || defined(__x86_64__)
+    #include <x86intrin.h>
+#elif defined(_M_IX86) || defined(_M_X64)
+    #include <intrin.h>
+#else
+    #include <chrono>
+#endif
+
+/**
+ * Hardware counters of the calling thread, counted only between start() and stop(): cycles, instructions,
+ * L1D, LLC and dTLB read misses and branch misses. Counters the kernel refuses (perf_event_paranoid, containers,
+ * no PMU, not Linux) are left out, and if none open at all the set is simply unavailable. Counts are scaled up
+ * when the kernel had to multiplex counters.
+ */
+class paint_perf_counters
+{
+public:
+    paint_perf_counters();
+    ~paint_perf_counters();
+    paint_perf_counters(const paint_perf_counters&) = delete;
+    paint_perf_counters& operator=(const paint_perf_counters&) = delete;
+
+    bool available() const
+    {
+        return !_events.empty();
+    }
+    // Why counters are missing, empty if all of them opened
+    const std::string& error() const
+    {
+        return _error;
+    }
+    void start();
+    void stop();
+    // Counts since construction, by counter name
+    std::vector<std::pair<const char*, double>> read() const;
+
+private:
+    struct event
+    {
+        const char* name;
+        int fd;
+    };
+    std::vector<event> _events;
+    std::string _error;
+};
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+// lfence, spelled so 32-bit builds without SSE2 enabled still get it
+inline void paint_ticks_fence()
+{
+    #ifdef _MSC_VER
+    _mm_lfence();
+    #else
+    asm volatile("lfence" ::: "memory");
+    #endif
+}
+#endif
+
+/**
+ * Timestamps cheap enough to time single sessions: the TSC on x86, steady_clock nanoseconds elsewhere.
+ * A timed stretch starts with paint_ticks_begin() and ends with paint_ticks_end(). On x86 the first waits for
+ * everything before it and the second for everything in the stretch, and nothing after it starts early, so the
+ * TSC reads cannot be reordered into or out of the work they bracket.
+ */
+inline uint64_t paint_ticks_begin()
+{
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+    paint_ticks_fence();
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+inline uint64_t paint_ticks_end()
+{
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+    unsigned int aux;
+    uint64_t ticks = __rdtscp(&aux);
+    paint_ticks_fence();
+    return ticks;
+#else
+    return paint_ticks_begin();
+#endif
+}
+
+// Nanoseconds per tick, calibrated against steady_clock the first time it is asked for
+double paint_tick_ns();
+
+// Ticks between back to back paint_ticks_begin() and paint_ticks_end(), which every timed stretch includes on top
+// of its work
+uint64_t paint_ticks_overhead();
+
+/**
+ * Flushes every line of `data` out of all cache levels, so the next access comes from memory. Builds without
+ * SSE2, and with it clflush, evict instead.
+ */
+void paint_cache_flush(const void* data, size_t size);
+
+/**
+ * Reads and dirties a buffer four times the size of L2, as the rest of a frame's work would, so L1 and L2 start out
+ * cold and only the last level cache keeps what fits next to the buffer.
+ */
+void paint_cache_evict();
@@ -0,0 +1,71 @@
+#include "psa_pipeline.h"
+
+#include <algorithm>
+
+paint_corpus_pipeline::paint_corpus_pipeline(std::vector<std::string> files, unsigned threads, size_t depth)
+    : _files(std::move(files))
+    , _depth(std::max<size_t>(depth, 1))
+{
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = (unsigned)std::min<size_t>(threads, _files.size());
+    for (unsigned i = 0; i < threads; i++)
+    {
+        _workers.emplace_back([this]() { work(); });
+    }
+}
+
+paint_corpus_pipeline::~paint_corpus_pipeline()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _consumed.notify_all();
+    for (auto& worker : _workers)
+    {
+        worker.join();
+    }
+}
+
+void paint_corpus_pipeline::work()
+{
+    // Captures are spread over the workers already, each one is inflated on its worker alone
+    paint_corpus_load_options options;
+    options.threads = 1;
+    options.verbose = false;
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        // Claimed captures count against the depth too, the consumer is blocked on the oldest one in the worst case
+        _consumed.wait(lock, [this]() { return _stop || _next_load >= _files.size() || _next_load < _next_out + _depth; });
+        if (_stop || _next_load >= _files.size())
+        {
+            return;
+        }
+        size_t index = _next_load++;
+        lock.unlock();
+        paint_corpus_ptr corpus = paint_corpus_load(_files[index].c_str(), options);
+        lock.lock();
+        _ready[index] = std::move(corpus);
+        _loaded.notify_all();
+    }
+}
+
+bool paint_corpus_pipeline::next(paint_corpus_ptr& corpus)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_next_out >= _files.size())
+    {
+        return false;
+    }
+    _loaded.wait(lock, [this]() { return _ready.count(_next_out) != 0; });
+    auto it = _ready.find(_next_out);
+    corpus = std::move(it->second);
+    _ready.erase(it);
+    _next_out++;
+    _consumed.notify_all();
+    return true;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "psa_corpus.h"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Loads captures on background threads while the consumer works on earlier ones. At most `depth` loaded corpora
+ * wait for the consumer at any time, so a directory of hundreds of captures never has to fit in memory at once.
+ * Corpora come out in the order of `files`, a capture that fails to load comes out as nullptr.
+ */
+class paint_corpus_pipeline
+{
+private:
+    std::vector<std::string> _files;
+    size_t _depth;
+    std::mutex _mutex;
+    std::condition_variable _loaded;
+    std::condition_variable _consumed;
+    std::map<size_t, paint_corpus_ptr> _ready;
+    size_t _next_load = 0;
+    size_t _next_out = 0;
+    bool _stop = false;
+    std::vector<std::thread> _workers;
+
+    void work();
+
+public:
+    // `threads` 0 for one per core
+    paint_corpus_pipeline(std::vector<std::string> files, unsigned threads, size_t depth);
+    ~paint_corpus_pipeline();
+    paint_corpus_pipeline(const paint_corpus_pipeline&) = delete;
+    paint_corpus_pipeline& operator=(const paint_corpus_pipeline&) = delete;
+
+    /**
+     * Waits for the next capture. Returns false once every capture has been handed out.
+     */
+    bool next(paint_corpus_ptr& corpus);
+};
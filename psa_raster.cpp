@@ -0,0 +1,273 @@
+#include "psa_raster.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+struct raster_point
+{
+    double x;
+    double y;
+};
+
+// World box of a struct, bounds being wrapping 16-bit coordinates. Inverted extents collapse to flat faces.
+struct raster_box
+{
+    int32_t x0, x1, y0, y1, z0, z1;
+
+    explicit raster_box(const paint_struct_bound_box& bounds)
+        : x0((int16_t)bounds.x)
+        , x1(std::max(x0, (int32_t)(int16_t)bounds.x_end))
+        , y0((int16_t)bounds.y)
+        , y1(std::max(y0, (int32_t)(int16_t)bounds.y_end))
+        , z0((int16_t)bounds.z)
+        , z1(std::max(z0, (int32_t)(int16_t)bounds.z_end))
+    {
+    }
+};
+
+// The game's translate_3d_to_2d for rotation 0, which is what arranged bounds are already expressed in
+static raster_point project(int32_t x, int32_t y, int32_t z)
+{
+    return { (double)(y - x), (x + y) / 2.0 - z };
+}
+
+bool paint_session_screen_extent(const paint_session& session, paint_screen_rect& extent)
+{
+    bool found = false;
+    for (const paint_struct* ps = session.PaintHead.next_quadrant_ps; ps != nullptr; ps = ps->next_quadrant_ps)
+    {
+        for (const paint_struct* child = ps; child != nullptr; child = child->children)
+        {
+            raster_box b(child->bounds);
+            paint_screen_rect r = { b.y0 - b.x1, (int32_t)std::floor((b.x0 + b.y0) / 2.0) - b.z1, b.y1 - b.x0,
+                                    (int32_t)std::ceil((b.x1 + b.y1) / 2.0) - b.z0 };
+            if (!found)
+            {
+                extent = r;
+                found = true;
+                continue;
+            }
+            extent.left = std::min(extent.left, r.left);
+            extent.top = std::min(extent.top, r.top);
+            extent.right = std::max(extent.right, r.right);
+            extent.bottom = std::max(extent.bottom, r.bottom);
+        }
+    }
+    return found;
+}
+
+// Fills the pixels whose centres fall inside a convex quad, one memset span per row
+static size_t fill_quad(const rct_drawpixelinfo& dpi, const raster_point (&quad)[4], uint8_t colour)
+{
+    double top = quad[0].y;
+    double bottom = quad[0].y;
+    for (const raster_point& p : quad)
+    {
+        top = std::min(top, p.y);
+        bottom = std::max(bottom, p.y);
+    }
+    int32_t row_begin = std::max(0, (int32_t)std::ceil(top - 0.5));
+    int32_t row_end = std::min((int32_t)dpi.height, (int32_t)std::ceil(bottom - 0.5));
+    size_t written = 0;
+    for (int32_t row = row_begin; row < row_end; row++)
+    {
+        double centre = row + 0.5;
+        double left = INFINITY;
+        double right = -INFINITY;
+        for (size_t i = 0; i < 4; i++)
+        {
+            const raster_point& p = quad[i];
+            const raster_point& q = quad[(i + 1) % 4];
+            if ((p.y <= centre) != (q.y <= centre))
+            {
+                double x = p.x + (centre - p.y) * (q.x - p.x) / (q.y - p.y);
+                left = std::min(left, x);
+                right = std::max(right, x);
+            }
+        }
+        int32_t column_begin = std::max(0, (int32_t)std::ceil(left - 0.5));
+        int32_t column_end = std::min((int32_t)dpi.width, (int32_t)std::ceil(right - 0.5));
+        if (column_begin < column_end)
+        {
+            std::memset(dpi.bits + (size_t)row * (dpi.width + dpi.pitch) + column_begin, colour, column_end - column_begin);
+            written += column_end - column_begin;
+        }
+    }
+    return written;
+}
+
+// Palette ramp of a sprite: 31 ramps of 8 shades follow the background ramp
+static uint8_t sprite_ramp(uint32_t image_id)
+{
+    uint32_t hash = (image_id & 0x7FFFF) * 2654435761u;
+    return (uint8_t)(1 + (hash >> 16) % 31);
+}
+
+static size_t draw_box(const rct_drawpixelinfo& dpi, const paint_struct& ps)
+{
+    raster_box b(ps.bounds);
+    double scale = 1 << dpi.zoom_level;
+    auto to_bitmap = [&](int32_t x, int32_t y, int32_t z) {
+        raster_point p = project(x, y, z);
+        return raster_point{ (p.x - dpi.x) / scale, (p.y - dpi.y) / scale };
+    };
+    raster_point top_back = to_bitmap(b.x0, b.y0, b.z1);
+    raster_point top_left = to_bitmap(b.x1, b.y0, b.z1);
+    raster_point top_front = to_bitmap(b.x1, b.y1, b.z1);
+    raster_point top_right = to_bitmap(b.x0, b.y1, b.z1);
+    raster_point bottom_left = to_bitmap(b.x1, b.y0, b.z0);
+    raster_point bottom_front = to_bitmap(b.x1, b.y1, b.z0);
+    raster_point bottom_right = to_bitmap(b.x0, b.y1, b.z0);
+
+    uint8_t ramp = (uint8_t)(sprite_ramp(ps.image_id) * 8);
+    size_t written = 0;
+    if (b.z1 > b.z0)
+    {
+        written += fill_quad(dpi, { top_left, top_front, bottom_front, bottom_left }, ramp + 4);
+        written += fill_quad(dpi, { top_front, top_right, bottom_right, bottom_front }, ramp + 2);
+    }
+    written += fill_quad(dpi, { top_back, top_left, top_front, top_right }, ramp + 6);
+    return written;
+}
+
+size_t paint_session_rasterise(const paint_session& session, const rct_drawpixelinfo& dpi)
+{
+    size_t written = 0;
+    for (const paint_struct* ps = session.PaintHead.next_quadrant_ps; ps != nullptr; ps = ps->next_quadrant_ps)
+    {
+        for (const paint_struct* child = ps; child != nullptr; child = child->children)
+        {
+            written += draw_box(dpi, *child);
+        }
+    }
+    return written;
+}
+
+const uint8_t* paint_raster_palette()
+{
+    static const std::vector<uint8_t> palette = [] {
+        std::vector<uint8_t> rgb(256 * 3);
+        for (int index = 0; index < 256; index++)
+        {
+            int ramp = index / 8;
+            double value = (index % 8 + 2) / 9.0;
+            double r = 0.2, g = 0.2, b = 0.25;
+            if (ramp != 0)
+            {
+                // Hues spread around the wheel, so neighbouring ramps are easy to tell apart
+                double hue = std::fmod(ramp * 137.5, 360.0) / 60.0;
+                double x = 1 - std::fabs(std::fmod(hue, 2.0) - 1);
+                const double sectors[6][3] = { { 1, x, 0 }, { x, 1, 0 }, { 0, 1, x }, { 0, x, 1 }, { x, 0, 1 }, { 1, 0, x } };
+                const double* c = sectors[(int)hue % 6];
+                r = 0.35 + 0.65 * c[0];
+                g = 0.35 + 0.65 * c[1];
+                b = 0.35 + 0.65 * c[2];
+            }
+            rgb[index * 3 + 0] = (uint8_t)std::lround(255 * r * value);
+            rgb[index * 3 + 1] = (uint8_t)std::lround(255 * g * value);
+            rgb[index * 3 + 2] = (uint8_t)std::lround(255 * b * value);
+        }
+        return rgb;
+    }();
+    return palette.data();
+}
+
+static void put_be32(std::vector<uint8_t>& out, uint32_t value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        out.push_back((uint8_t)(value >> shift));
+    }
+}
+
+static void put_png_chunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size)
+{
+    put_be32(out, (uint32_t)size);
+    size_t begin = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    put_be32(out, (uint32_t)crc32(0, out.data() + begin, (uInt)(out.size() - begin)));
+}
+
+// Empty if the pixels could not be deflated
+static std::vector<uint8_t> encode_png(const rct_drawpixelinfo& dpi)
+{
+    std::vector<uint8_t> header;
+    put_be32(header, dpi.width);
+    put_be32(header, dpi.height);
+    // 8 bit palette indices, default compression and filtering, no interlace
+    header.insert(header.end(), { 8, 3, 0, 0, 0 });
+
+    // Every row gets filter type 0, the pixels themselves are deflated as they are
+    std::vector<uint8_t> rows;
+    rows.reserve((size_t)dpi.height * (dpi.width + 1));
+    for (int32_t row = 0; row < dpi.height; row++)
+    {
+        const uint8_t* bits = dpi.bits + (size_t)row * (dpi.width + dpi.pitch);
+        rows.push_back(0);
+        rows.insert(rows.end(), bits, bits + dpi.width);
+    }
+    uLongf size = compressBound((uLong)rows.size());
+    std::vector<uint8_t> compressed(size);
+    if (compress2(compressed.data(), &size, rows.data(), (uLong)rows.size(), Z_DEFAULT_COMPRESSION) != Z_OK)
+    {
+        return {};
+    }
+
+    static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    std::vector<uint8_t> png(std::begin(signature), std::end(signature));
+    put_png_chunk(png, "IHDR", header.data(), header.size());
+    put_png_chunk(png, "PLTE", paint_raster_palette(), 256 * 3);
+    put_png_chunk(png, "IDAT", compressed.data(), size);
+    put_png_chunk(png, "IEND", nullptr, 0);
+    return png;
+}
+
+static std::vector<uint8_t> encode_ppm(const rct_drawpixelinfo& dpi)
+{
+    std::string header = "P6\n" + std::to_string(dpi.width) + " " + std::to_string(dpi.height) + "\n255\n";
+    std::vector<uint8_t> ppm(header.begin(), header.end());
+    ppm.reserve(ppm.size() + (size_t)dpi.width * dpi.height * 3);
+    const uint8_t* palette = paint_raster_palette();
+    for (int32_t row = 0; row < dpi.height; row++)
+    {
+        const uint8_t* bits = dpi.bits + (size_t)row * (dpi.width + dpi.pitch);
+        for (int32_t column = 0; column < dpi.width; column++)
+        {
+            ppm.insert(ppm.end(), palette + bits[column] * 3, palette + bits[column] * 3 + 3);
+        }
+    }
+    return ppm;
+}
+
+bool paint_raster_write(const rct_drawpixelinfo& dpi, const char* fname)
+{
+    std::string name = fname;
+    bool png = name.size() >= 4 && name.compare(name.size() - 4, 4, ".png") == 0;
+    std::vector<uint8_t> data = png ? encode_png(dpi) : encode_ppm(dpi);
+    if (data.empty())
+    {
+        std::cout << "Could not encode " << fname << std::endl;
+        return false;
+    }
+    FILE* file = fopen(fname, "wb");
+    if (file == nullptr)
+    {
+        std::cout << "Could not write " << fname << std::endl;
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+    {
+        std::cout << "Could not write " << fname << std::endl;
+        return false;
+    }
+    return true;
+}
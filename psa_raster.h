@@ -0,0 +1,41 @@
+#pragma once
+#include "structs.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Headless stand-in for the game's sprite drawing: every struct of an arranged session becomes a flat shaded
+ * isometric box built from its bounds, so draw order can be looked at and diffed between engines.
+ *
+ * The bitmap is described by an rct_drawpixelinfo: `x` and `y` are the unzoomed screen position of its top left
+ * pixel, `width` and `height` are in pixels, rows are `width + pitch` bytes apart and a screen point p lands on
+ * pixel (p - x) >> zoom_level. Pixels are palette indices, see paint_raster_palette().
+ */
+
+struct paint_screen_rect
+{
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+};
+
+/**
+ * Unzoomed screen rectangle covering every box of the session. Returns false if there is nothing to draw.
+ */
+bool paint_session_screen_extent(const paint_session& session, paint_screen_rect& extent);
+
+/**
+ * Draws the session's arranged list, PaintHead onwards with children, back to front. The bitmap is not cleared
+ * first. Returns the number of pixels written.
+ */
+size_t paint_session_rasterise(const paint_session& session, const rct_drawpixelinfo& dpi);
+
+// 256 RGB triplets, index 0 being the background
+const uint8_t* paint_raster_palette();
+
+/**
+ * Writes the bitmap as an indexed PNG if `fname` ends in .png, as a binary PPM otherwise.
+ */
+bool paint_raster_write(const rct_drawpixelinfo& dpi, const char* fname);
@@ -0,0 +1,115 @@
+#include "psa_submit.h"
+
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+#include <vector>
+
+static constexpr uint32_t paint_struct_capacity = sizeof(paint_session::PaintStructs) / sizeof(paint_entry);
+
+paint_session_submitter::paint_session_submitter(paint_session* session)
+    : _session(session)
+{
+    reset();
+}
+
+void paint_session_submitter::reset()
+{
+    _next_free.store(0, std::memory_order_relaxed);
+    for (auto& quadrant : _quadrants)
+    {
+        quadrant.store(0, std::memory_order_relaxed);
+    }
+}
+
+paint_struct* paint_session_submitter::submit(const paint_struct& ps)
+{
+    if (ps.quadrant_index >= MAX_PAINT_QUADRANTS)
+    {
+        return nullptr;
+    }
+    uint32_t index = _next_free.fetch_add(1, std::memory_order_relaxed);
+    if (index >= paint_struct_capacity)
+    {
+        return nullptr;
+    }
+    paint_entry* pool = _session->PaintStructs;
+    paint_struct* slot = &pool[index].basic;
+    *slot = ps;
+    slot->attached_ps = nullptr;
+    slot->children = nullptr;
+
+    std::atomic<uint32_t>& head = _quadrants[slot->quadrant_index];
+    uint32_t old_head = head.load(std::memory_order_relaxed);
+    do
+    {
+        slot->next_quadrant_ps = old_head == 0 ? nullptr : &pool[old_head - 1].basic;
+    } while (!head.compare_exchange_weak(old_head, index + 1, std::memory_order_release, std::memory_order_relaxed));
+    return slot;
+}
+
+// Orders by every field but the links, which finish() rewrites. Structs that tie on all of them can only differ in
+// padding, so that decides last and structs that still tie are identical byte for byte.
+static bool paint_struct_canonical_less(const paint_struct& a, const paint_struct& b)
+{
+    const auto& ab = a.bounds;
+    const auto& bb = b.bounds;
+    auto a_tile = (uintptr_t)a.tileElement;
+    auto b_tile = (uintptr_t)b.tileElement;
+    auto a_key = std::tie(a.quadrant_index, ab.x, ab.y, ab.z, ab.x_end, ab.y_end, ab.z_end, a.x, a.y, a.image_id,
+        a.colour_image_id, a.flags, a.quadrant_flags, a.sprite_type, a.var_29, a.pad_2A, a.map_x, a.map_y, a_tile);
+    auto b_key = std::tie(b.quadrant_index, bb.x, bb.y, bb.z, bb.x_end, bb.y_end, bb.z_end, b.x, b.y, b.image_id,
+        b.colour_image_id, b.flags, b.quadrant_flags, b.sprite_type, b.var_29, b.pad_2A, b.map_x, b.map_y, b_tile);
+    if (a_key != b_key)
+    {
+        return a_key < b_key;
+    }
+    paint_struct a_bytes, b_bytes;
+    std::memcpy(&a_bytes, &a, sizeof(paint_struct));
+    std::memcpy(&b_bytes, &b, sizeof(paint_struct));
+    a_bytes.next_quadrant_ps = nullptr;
+    b_bytes.next_quadrant_ps = nullptr;
+    return std::memcmp(&a_bytes, &b_bytes, sizeof(paint_struct)) < 0;
+}
+
+void paint_session_submitter::finish()
+{
+    // Producers have been synchronised with by the caller (e.g. joined), so relaxed loads see all their work
+    uint32_t count = std::min(_next_free.load(std::memory_order_relaxed), paint_struct_capacity);
+
+    // Only structs that made it onto a quadrant list count, a slot can be taken but never published.
+    // Structs that compare equal are identical, so their relative order cannot be observed.
+    std::vector<paint_struct> structs;
+    structs.reserve(count);
+    for (auto& quadrant : _quadrants)
+    {
+        uint32_t head = quadrant.load(std::memory_order_relaxed);
+        for (const paint_struct* ps = head == 0 ? nullptr : &_session->PaintStructs[head - 1].basic; ps != nullptr;
+             ps = ps->next_quadrant_ps)
+        {
+            structs.push_back(*ps);
+        }
+    }
+    std::sort(structs.begin(), structs.end(), paint_struct_canonical_less);
+
+    for (auto& quadrant : _session->Quadrants)
+    {
+        quadrant = nullptr;
+    }
+    _session->QuadrantBackIndex = UINT32_MAX;
+    _session->QuadrantFrontIndex = 0;
+    paint_entry* pool = _session->PaintStructs;
+    // Walk backwards so every quadrant list ends up in canonical order
+    for (size_t i = structs.size(); i-- > 0;)
+    {
+        paint_struct& ps = pool[i].basic;
+        ps = structs[i];
+        ps.next_quadrant_ps = _session->Quadrants[ps.quadrant_index];
+        _session->Quadrants[ps.quadrant_index] = &ps;
+        _session->QuadrantBackIndex = std::min<uint32_t>(_session->QuadrantBackIndex, ps.quadrant_index);
+        _session->QuadrantFrontIndex = std::max<uint32_t>(_session->QuadrantFrontIndex, ps.quadrant_index);
+    }
+    _session->NextFreePaintStruct = &pool[structs.size()];
+    _session->EndOfPaintStructArray = &pool[paint_struct_capacity - 1];
+    reset();
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "structs.h"
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Lets several paint generator threads add structs to one session at the same time.
+ * Slots come from the session's PaintStructs pool through an atomic bump and each struct is
+ * prepended to its quadrant list with a CAS on the quadrant head.
+ *
+ * Once all producers are done (and synchronised with the caller), finish() canonicalises the session:
+ * structs are reordered in the pool and in their quadrant lists by quadrant and content, so the session,
+ * and therefore the output of paint_session_arrange(), does not depend on how producers interleaved.
+ */
+class paint_session_submitter
+{
+public:
+    explicit paint_session_submitter(paint_session* session);
+
+    /**
+     * Clears the session's quadrants and pool so it can be filled again.
+     */
+    void reset();
+
+    /**
+     * Copies `ps` into a free slot and queues it on Quadrants[ps.quadrant_index]. Links in `ps` are not carried over.
+     * Safe to call from multiple threads. Returns nullptr when the pool is exhausted, like the game's allocator, and
+     * for a quadrant_index past MAX_PAINT_QUADRANTS, which is left unqueued rather than filed under another quadrant.
+     */
+    paint_struct* submit(const paint_struct& ps);
+
+    /**
+     * Makes the session deterministic and ready for paint_session_arrange(). Not thread-safe.
+     */
+    void finish();
+
+private:
+    paint_session* _session;
+    std::atomic<uint32_t> _next_free;
+    // Index of the head struct plus one, 0 for an empty quadrant
+    std::atomic<uint32_t> _quadrants[MAX_PAINT_QUADRANTS];
+};
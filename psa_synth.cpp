@@ -0,0 +1,97 @@
+#include "psa_synth.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+// World units per tile side, and per quadrant along x + y
+constexpr int32_t tile_size = 32;
+// Half width of the screen column a session covers, in world units of y - x
+constexpr int32_t column_half_width = 48;
+
+// Lays out a scene seen from rotation 0. Sessions must already be value-initialised.
+static void generate_session(paint_session& session, const paint_scene_options& options, uint32_t seed)
+{
+    // Only raw engine output is used, distributions are not portable across standard libraries
+    std::mt19937 random(seed);
+    auto next = [&random](uint32_t range) { return range == 0 ? 0 : random() % range; };
+
+    uint32_t back = (MAX_PAINT_QUADRANTS - options.quadrants) / 2;
+    int32_t footprint = std::max(1, (int32_t)(options.overlap * tile_size / 100));
+    session.QuadrantBackIndex = UINT32_MAX;
+    session.QuadrantFrontIndex = 0;
+    for (uint32_t i = 0; i < options.structs; i++)
+    {
+        uint32_t quadrant = back + next(options.quadrants);
+        int32_t sum = (int32_t)(quadrant * tile_size + next(tile_size));
+        int32_t difference = (int32_t)next(2 * column_half_width + 1) - column_half_width;
+        int32_t z = 0;
+        int32_t height = 1 + (int32_t)next(32);
+        if (options.heights == paint_scene_heights::uniform)
+        {
+            z = (int32_t)next(options.max_height);
+        }
+        else if (options.heights == paint_scene_heights::stacked)
+        {
+            // One tower per quadrant, so each struct is exactly above the ones before it
+            sum = (int32_t)(quadrant * tile_size + tile_size / 2);
+            difference = 0;
+            height = 4;
+            z = (int32_t)i * height;
+        }
+        int32_t x = (sum - difference) / 2;
+        int32_t y = sum - x;
+
+        paint_struct& ps = session.PaintStructs[i].basic;
+        ps.image_id = 1000 + next(64);
+        ps.bounds.x = (uint16_t)x;
+        ps.bounds.y = (uint16_t)y;
+        ps.bounds.z = (uint16_t)z;
+        ps.bounds.x_end = (uint16_t)(x + footprint);
+        ps.bounds.y_end = (uint16_t)(y + footprint);
+        ps.bounds.z_end = (uint16_t)(z + height);
+        // translate_3d_to_2d of the near corner, like the captured structs
+        ps.x = (uint16_t)(y - x);
+        ps.y = (uint16_t)((x + y) / 2 - z);
+        ps.quadrant_index = (uint16_t)quadrant;
+        ps.next_quadrant_ps = session.Quadrants[quadrant];
+        session.Quadrants[quadrant] = &ps;
+        session.QuadrantBackIndex = std::min(session.QuadrantBackIndex, quadrant);
+        session.QuadrantFrontIndex = std::max(session.QuadrantFrontIndex, quadrant);
+    }
+}
+
+paint_corpus_ptr paint_scene_generate(const paint_scene_options& options, size_t count)
+{
+    if (options.structs > sizeof(paint_session::PaintStructs) / sizeof(paint_entry) || options.quadrants == 0
+        || options.quadrants > MAX_PAINT_QUADRANTS || options.rotation > 3)
+    {
+        return nullptr;
+    }
+    // Linked in place: moving the vector into the corpus leaves every session where it is
+    std::vector<paint_session> sessions(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (options.rotation == 0)
+        {
+            generate_session(sessions[i], options, options.seed + (uint32_t)i);
+            continue;
+        }
+        // Turned afterwards, so every rotation arranges the same scene from its own side
+        auto scene = std::make_unique<paint_session>();
+        generate_session(*scene, options, options.seed + (uint32_t)i);
+        paint_session_rotate(*scene, options.rotation, sessions[i]);
+    }
+    std::string name = paint_scene_describe(options);
+    return paint_corpus_create(name, name, std::move(sessions));
+}
+
+std::string paint_scene_describe(const paint_scene_options& options)
+{
+    static const char* heights[] = { "flat", "uniform", "stacked" };
+    return "synthetic structs=" + std::to_string(options.structs) + " quadrants=" + std::to_string(options.quadrants)
+        + " overlap=" + std::to_string(options.overlap) + " rotation=" + std::to_string(options.rotation)
+        + " heights=" + heights[(uint32_t)options.heights] + " max_height=" + std::to_string(options.max_height)
+        + " seed=" + std::to_string(options.seed);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "psa_corpus.h"
+
+#include <cstdint>
+#include <string>
+
+enum class paint_scene_heights : uint32_t
+{
+    // Everything on the ground
+    flat = 0,
+    // Base heights spread evenly below max_height
+    uniform = 1,
+    // A tower per quadrant, each struct on top of the one generated before it, ignoring max_height. Arrange still
+    // compares every pair, but the list is in order after the first pass and the rest are predictable misses.
+    stacked = 2,
+};
+
+/**
+ * Knobs of a synthetic scene. Structs sit in a narrow screen column, as in a real session, and are spread over
+ * `quadrants` consecutive quadrants around the middle of the quadrant range.
+ * The arrange helper compares every pair of structs within neighbouring quadrants, so one quadrant is quadratic.
+ * It is slowest with small boxes at uniform heights below 16, where about a sixth of the comparisons relink.
+ */
+struct paint_scene_options
+{
+    // At most 4000, the size of the pool
+    uint32_t structs = 1000;
+    // 1 to MAX_PAINT_QUADRANTS
+    uint32_t quadrants = 32;
+    // Box footprint in percent of a tile side. Positions are random, so larger boxes overlap more of their neighbours
+    uint32_t overlap = 50;
+    // Camera rotation 0 to 3. The scene is laid out for rotation 0 and then turned, see paint_session_rotate().
+    uint8_t rotation = 0;
+    paint_scene_heights heights = paint_scene_heights::uniform;
+    uint16_t max_height = 256;
+    uint32_t seed = 1;
+};
+
+/**
+ * Builds `count` sessions from consecutive seeds, linked the way the game's generation links them. Returns
+ * nullptr if the options are out of range.
+ */
+paint_corpus_ptr paint_scene_generate(const paint_scene_options& options, size_t count);
+
+// Short description of the options, used as corpus name and park
+std::string paint_scene_describe(const paint_scene_options& options);
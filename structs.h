@@ -13,6 +13,93 @@ enum PAINT_QUADRANT_FLAGS
 #define MAX_PAINT_QUADRANTS 512
 #define TUNNEL_MAX_COUNT 65
 
+// MSVC caps alignas() at 8192, far below a session window, so it keeps native pointers
+#if defined(WITH_COMPRESSED_POINTERS) && !(defined(__i386__) || defined(_M_IX86)) && !defined(_MSC_VER)
+#define PSA_COMPRESSED_POINTERS
+#endif
+
+#ifdef PSA_COMPRESSED_POINTERS
+// Every paint_session occupies its own naturally aligned window of this size, which lets
+// a link find its session base by masking its own address. The session itself needs 210 KB, so
+// the padding adds 24%. That is still 10% less than a native session of 293 KB on x86_64.
+#define PAINT_SESSION_ALIGNMENT 0x40000
+
+#if defined(__clang__)
+#define PSA_ASSUME(x) __builtin_assume(x)
+#elif defined(__GNUC__)
+#define PSA_ASSUME(x) do { if (!(x)) __builtin_unreachable(); } while (0)
+#elif defined(_MSC_VER)
+#define PSA_ASSUME(x) __assume(x)
+#else
+#define PSA_ASSUME(x) ((void)0)
+#endif
+
+/**
+ * Link to an object inside the same paint_session, stored as a 32-bit byte offset from the
+ * session base. Offset 0 is the session's DPI, which is never a link target, so it encodes nullptr.
+ * Since offsets are session-relative, bit-exact copies of a whole session remain valid.
+ * Only assign to links that already live inside a paint_session.
+ */
+template<typename T> struct paint_ptr
+{
+    uint32_t offset;
+
+    uintptr_t base() const
+    {
+        return (uintptr_t)this & ~(uintptr_t)(PAINT_SESSION_ALIGNMENT - 1);
+    }
+    T* get() const
+    {
+        if (offset == 0)
+            return nullptr;
+        T* ptr = (T*)(base() + offset);
+        // Lets the compiler test the offset instead of the decoded pointer
+        PSA_ASSUME(ptr != nullptr);
+        return ptr;
+    }
+    operator T*() const
+    {
+        return get();
+    }
+    T* operator->() const
+    {
+        return get();
+    }
+    paint_ptr& operator=(T* ptr)
+    {
+        offset = ptr == nullptr ? 0 : (uint32_t)((uintptr_t)ptr - base());
+        return *this;
+    }
+};
+#define PAINT_SESSION_ALIGN alignas(PAINT_SESSION_ALIGNMENT)
+#else
+template<typename T> using paint_ptr = T*;
+#define PAINT_SESSION_ALIGN
+#endif
+
+// Decoders may park the raw index of a link's target in the link itself until it is resolved into the link
+template<typename T> inline void set_link_index(T*& link, uint32_t index)
+{
+    link = (T*)(uintptr_t)index;
+}
+
+template<typename T> inline uint32_t get_link_index(T* link)
+{
+    return (uint32_t)(uintptr_t)link;
+}
+
+#ifdef PSA_COMPRESSED_POINTERS
+template<typename T> inline void set_link_index(paint_ptr<T>& link, uint32_t index)
+{
+    link.offset = index;
+}
+
+template<typename T> inline uint32_t get_link_index(const paint_ptr<T>& link)
+{
+    return link.offset;
+}
+#endif
+
 
 #pragma pack(push, 1)
 /* size 0x12 */
@@ -29,16 +116,16 @@ struct attached_paint_struct
     uint16_t y;    // 0x0A
     uint8_t flags; // 0x0C
     uint8_t pad_0D;
-    attached_paint_struct* next; // 0x0E
+    paint_ptr<attached_paint_struct> next; // 0x0E
 };
-#if defined(__i386__) || defined(_M_IX86)
+#if defined(__i386__) || defined(_M_IX86) || defined(PSA_COMPRESSED_POINTERS)
 assert_struct_size(attached_paint_struct, 0x12);
 #endif
 
 struct paint_string_struct
 {
     uint16_t string_id;   // 0x00
-    paint_string_struct* next; // 0x02
+    paint_ptr<paint_string_struct> next; // 0x02
     uint16_t x;                // 0x06
     uint16_t y;                // 0x08
     uint32_t args[4];          // 0x0A
@@ -89,17 +176,22 @@ struct paint_struct
     uint16_t quadrant_index;
     uint8_t flags;
     uint8_t quadrant_flags;
-    attached_paint_struct* attached_ps; // 0x1C
-    paint_struct* children;
-    paint_struct* next_quadrant_ps; // 0x24
+    paint_ptr<attached_paint_struct> attached_ps; // 0x1C
+    paint_ptr<paint_struct> children;
+    paint_ptr<paint_struct> next_quadrant_ps; // 0x24
     uint8_t sprite_type;            // 0x28
     uint8_t var_29;
     uint16_t pad_2A;
     uint16_t map_x;           // 0x2C
     uint16_t map_y;           // 0x2E
+#ifdef PSA_COMPRESSED_POINTERS
+    // The map lives outside the session, so this can only be an opaque id here, never a session offset
+    uint32_t tileElement; // 0x30 (or sprite pointer)
+#else
     TileElement* tileElement; // 0x30 (or sprite pointer)
+#endif
 };
-#if defined(__i386__) || defined(_M_IX86)
+#if defined(__i386__) || defined(_M_IX86) || defined(PSA_COMPRESSED_POINTERS)
 assert_struct_size(paint_struct, 0x34);
 #endif
 
@@ -142,28 +234,28 @@ struct tunnel_entry
     uint8_t type;
 };
 
-struct paint_session
+struct PAINT_SESSION_ALIGN paint_session
 {
     rct_drawpixelinfo DPI;
     paint_entry PaintStructs[4000];
-    paint_struct* Quadrants[MAX_PAINT_QUADRANTS];
+    paint_ptr<paint_struct> Quadrants[MAX_PAINT_QUADRANTS];
     paint_struct PaintHead;
     uint32_t ViewFlags;
     uint32_t QuadrantBackIndex;
     uint32_t QuadrantFrontIndex;
     const void* CurrentlyDrawnItem;
-    paint_entry* EndOfPaintStructArray;
-    paint_entry* NextFreePaintStruct;
+    paint_ptr<paint_entry> EndOfPaintStructArray;
+    paint_ptr<paint_entry> NextFreePaintStruct;
     CoordsXY SpritePosition;
-    paint_struct* LastRootPS;
-    attached_paint_struct* UnkF1AD2C;
+    paint_ptr<paint_struct> LastRootPS;
+    paint_ptr<attached_paint_struct> UnkF1AD2C;
     uint8_t InteractionType;
     uint8_t CurrentRotation;
     support_height SupportSegments[9];
     support_height Support;
-    paint_string_struct* PSStringHead;
-    paint_string_struct* LastPSString;
-    paint_struct* WoodenSupportsPrependTo;
+    paint_ptr<paint_string_struct> PSStringHead;
+    paint_ptr<paint_string_struct> LastPSString;
+    paint_ptr<paint_struct> WoodenSupportsPrependTo;
     CoordsXY MapPosition;
     tunnel_entry LeftTunnels[TUNNEL_MAX_COUNT];
     uint8_t LeftTunnelCount;
@@ -178,3 +270,6 @@ struct paint_session
     uint16_t WaterHeight;
     uint32_t TrackColours[4];
 };
+#ifdef PSA_COMPRESSED_POINTERS
+static_assert(sizeof(paint_session) == PAINT_SESSION_ALIGNMENT, "paint_session must fit its alignment window");
+#endif